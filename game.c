@@ -1,7 +1,26 @@
 #include "raylib.h"
 #include <stdlib.h>
 #include <stdbool.h>
+#include <limits.h>
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
 
 #define EMPTY 0
 #define SAND 1
@@ -16,6 +35,45 @@
 #define DIRT 10
 #define GRASS_SEED 11
 #define GRASS 12
+#define MATERIAL_COUNT 13
+
+const char* materialNames[MATERIAL_COUNT] = {
+    "EMPTY", "SAND", "WATER", "STONE", "ACID", "GAS", "FIRE",
+    "ACID_GAS", "STEAM", "RAIN", "DIRT", "GRASS_SEED", "GRASS"
+};
+
+// Timer planes that belong to a single cell and must be cleared when its material changes.
+// The two gas planes hold concentrations in GAS_UNITs (one full cell of gas).
+#define TIMER_PLANE_COUNT 7
+#define PLANE_ACID_STAGE 0
+#define PLANE_ACID_TIMER 1
+#define PLANE_FIRE_TIMER 2
+#define PLANE_GAS_DENSITY 3
+#define PLANE_ACID_GAS_DENSITY 4
+#define PLANE_STEAM_TIMER 5
+#define PLANE_GROWTH_TIMER 6
+
+#define GAS_UNIT 65536
+
+#define EVAPORATION_TIME (20 * 60)
+
+// Materials whose colour depends on a timer and so changes without moving
+const bool animatedMaterial[MATERIAL_COUNT] = {
+    [ACID] = true, [FIRE] = true, [STEAM] = true
+};
+
+// Chunks of CHUNK_SIZE x CHUNK_SIZE cells keep a colour pyramid for zoomed-out drawing.
+// Level 1 is 16x16 texels, level 5 a single texel; level 0 is the cells themselves.
+#define CHUNK_SIZE 32
+#define CHUNK_LOD_LEVELS 5
+#define CHUNK_LOD_TEXELS (256 + 64 + 16 + 4 + 1)
+const int lodLevelOffsets[CHUNK_LOD_LEVELS + 1] = {0, 0, 256, 320, 336, 340};
+
+// Below this many pixels per cell the grid is drawn through a texture instead of per-cell rectangles
+#define LOD_MIN_ZOOM 4.0f
+#define MIN_ZOOM (1.0f / CHUNK_SIZE)
+#define MAX_ZOOM 40.0f
+#define TOOLBAR_WIDTH 150
 
 // Define acid color stages (from light to dark green)
 Color acidColors[5] = {
@@ -52,144 +110,407 @@ Color steamColors[3] = {
 // Define rain droplet color
 Color rainColor = (Color){50, 150, 255, 220};
 
-// Physics functions
-bool updateFalling(int gridHeight, int gridWidth, int** grid, int x, int y, int element) {
-    if (y + 1 < gridHeight && grid[y + 1][x] == EMPTY) {
-        grid[y + 1][x] = element;
-        grid[y][x] = EMPTY;
-        return true;
+// Fast xorshift generator used by the simulation. Each cell update reseeds it
+// from the world seed, the tick and the cell's world position, so results do not
+// depend on the order in which cells, domains or threads are visited.
+_Thread_local unsigned int rngState = 2463534242u;
+
+unsigned int fastRandom(void) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+unsigned int hashCoords(unsigned int seed, long tick, int x, int y) {
+    unsigned int h = seed ^ ((unsigned int)tick * 0x9E3779B1u) ^
+                     ((unsigned int)x * 0x85EBCA77u) ^ ((unsigned int)y * 0xC2B2AE3Du);
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
+
+void seedCellRandom(unsigned int seed, long tick, int x, int y) {
+    unsigned int h = hashCoords(seed, tick, x, y);
+    rngState = h ? h : 2463534242u;
+}
+
+// Uniform integer in [min, max], like GetRandomValue
+int randomRange(int min, int max) {
+    return min + (int)(fastRandom() % (unsigned int)(max - min + 1));
+}
+
+// Reactions: when cell A has neighbour B on the given side, with the given
+// probability A becomes resultA and B becomes resultB.
+#define REACTION_FILE "reactions.txt"
+#define MAX_REACTION_RULES 128
+
+// Neighbour sides, in the order the reaction pass visits them
+#define SIDE_BELOW 0
+#define SIDE_RIGHT 1
+#define SIDE_ABOVE 2
+#define SIDE_LEFT 3
+
+const int sideOffsets[4][2] = {{0, 1}, {1, 0}, {0, -1}, {-1, 0}};
+
+typedef struct {
+    int a;
+    int b;
+    int sides;          // Bitmask of SIDE_* the rule applies to
+    float probability;
+    int resultA;
+    int resultB;
+    bool stop;          // Firing ends A's turn: no further reactions or movement this tick
+} ReactionRule;
+
+// Compiled form: probability is a threshold compared against 31 random bits
+typedef struct {
+    unsigned int threshold;
+    unsigned char resultA;
+    unsigned char resultB;
+    bool stop;
+} Reaction;
+
+const char* defaultReactions[] = {
+    "ACID SAND any 1.0 ACID EMPTY stop",
+    "ACID STONE any 1.0 ACID EMPTY stop",
+    "FIRE WATER any 1.0 FIRE STEAM",
+    "FIRE STEAM any 1.0 FIRE EMPTY",
+    "GAS FIRE any 1.0 FIRE FIRE",
+    "GRASS_SEED DIRT below 1.0 GRASS DIRT",
+    "ACID GRASS any 1.0 ACID EMPTY stop",
+    "FIRE GRASS any 0.5 FIRE FIRE",
+};
+
+ReactionRule reactionRules[MAX_REACTION_RULES];
+int reactionRuleCount = 0;
+Reaction reactionTable[4][MATERIAL_COUNT][MATERIAL_COUNT];
+bool hasReactions[MATERIAL_COUNT];
+unsigned int reactionPartners[MATERIAL_COUNT];  // Bit b set when A has a rule with neighbour b
+
+int findMaterial(const char* name) {
+    for (int i = 0; i < MATERIAL_COUNT; i++) {
+        if (strcmp(materialNames[i], name) == 0) {
+            return i;
+        }
     }
-    if (y + 1 < gridHeight && (grid[y + 1][x] == WATER || grid[y + 1][x] == GAS || grid[y + 1][x] == ACID_GAS)) {
-        int temp = grid[y + 1][x];
-        grid[y + 1][x] = element;
-        grid[y][x] = temp;
-        return true;
+    return -1;
+}
+
+bool parseReactionRule(const char* line, ReactionRule* rule) {
+    char a[32], b[32], side[16], resultA[32], resultB[32], flag[16];
+    float probability;
+
+    int fields = sscanf(line, "%31s %31s %15s %f %31s %31s %15s", a, b, side, &probability, resultA, resultB, flag);
+    if (fields < 6) {
+        return false;
+    }
+    rule->stop = false;
+    if (fields == 7) {
+        if (strcmp(flag, "stop") != 0) {
+            return false;
+        }
+        rule->stop = true;
     }
 
-    int dir = (GetRandomValue(0, 1) == 0) ? -1 : 1;
-    if (x + dir >= 0 && x + dir < gridWidth && y + 1 < gridHeight && grid[y + 1][x + dir] == EMPTY) {
-        grid[y + 1][x + dir] = element;
-        grid[y][x] = EMPTY;
-        return true;
+    rule->a = findMaterial(a);
+    rule->b = findMaterial(b);
+    rule->resultA = findMaterial(resultA);
+    rule->resultB = findMaterial(resultB);
+    if (rule->a < 0 || rule->b < 0 || rule->resultA < 0 || rule->resultB < 0) {
+        return false;
     }
 
-    int otherDir = -dir;
-    if (x + otherDir >= 0 && x + otherDir < gridWidth && y + 1 < gridHeight && grid[y + 1][x + otherDir] == EMPTY) {
-        grid[y + 1][x + otherDir] = element;
-        grid[y][x] = EMPTY;
-        return true;
+    if (strcmp(side, "any") == 0) {
+        rule->sides = 0xF;
+    } else if (strcmp(side, "below") == 0) {
+        rule->sides = 1 << SIDE_BELOW;
+    } else if (strcmp(side, "above") == 0) {
+        rule->sides = 1 << SIDE_ABOVE;
+    } else if (strcmp(side, "side") == 0) {
+        rule->sides = (1 << SIDE_LEFT) | (1 << SIDE_RIGHT);
+    } else {
+        return false;
     }
 
-    return false;
+    if (probability < 0.0f) probability = 0.0f;
+    if (probability > 1.0f) probability = 1.0f;
+    rule->probability = probability;
+    return true;
 }
 
-bool updateSand(int gridHeight, int gridWidth, int** grid, int x, int y) {
-    return updateFalling(gridHeight, gridWidth, grid, x, y, SAND);
+void addReactionRule(const char* line) {
+    if (reactionRuleCount >= MAX_REACTION_RULES) {
+        return;
+    }
+    if (parseReactionRule(line, &reactionRules[reactionRuleCount])) {
+        reactionRuleCount++;
+    } else {
+        TraceLog(LOG_WARNING, "Ignoring bad reaction rule: %s", line);
+    }
 }
 
-bool updateDirt(int gridHeight, int gridWidth, int** grid, int x, int y) {
-    return updateFalling(gridHeight, gridWidth, grid, x, y, DIRT);
-}
+// Load rules from a text file, one "A B side probability A' B' [stop]" per line.
+// Falls back to the built-in rules when the file cannot be opened.
+void loadReactions(const char* path) {
+    reactionRuleCount = 0;
 
-bool updateWater(int gridHeight, int gridWidth, int** grid, int x, int y) {
-    if (y - 1 >= 0 && grid[y - 1][x] == SAND) {
-        grid[y - 1][x] = WATER;
-        grid[y][x] = SAND;
-        return true;
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        for (int i = 0; i < (int)(sizeof(defaultReactions) / sizeof(defaultReactions[0])); i++) {
+            addReactionRule(defaultReactions[i]);
+        }
+        return;
     }
 
-    if (y + 1 < gridHeight && (grid[y + 1][x] == EMPTY || grid[y + 1][x] == GAS || grid[y + 1][x] == ACID_GAS)) {
-        int temp = grid[y + 1][x];
-        grid[y + 1][x] = WATER;
-        grid[y][x] = temp;
-        return true;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        char* start = line;
+        while (*start == ' ' || *start == '\t') start++;
+        if (*start == '#' || *start == '\n' || *start == '\r' || *start == '\0') {
+            continue;
+        }
+        addReactionRule(start);
     }
+    fclose(file);
+}
 
-    int dir = (GetRandomValue(0, 1) == 0) ? -1 : 1;
-    if (x + dir >= 0 && x + dir < gridWidth && y + 1 < gridHeight && (grid[y + 1][x + dir] == EMPTY || grid[y + 1][x + dir] == GAS || grid[y + 1][x + dir] == ACID_GAS)) {
-        int temp = grid[y + 1][x + dir];
-        grid[y + 1][x + dir] = WATER;
-        grid[y][x] = temp;
-        return true;
+// Build the dense lookup: every (side, A, B) entry exists, and entries with
+// no rule have a zero threshold and results equal to their inputs.
+void compileReactions(void) {
+    for (int side = 0; side < 4; side++) {
+        for (int a = 0; a < MATERIAL_COUNT; a++) {
+            for (int b = 0; b < MATERIAL_COUNT; b++) {
+                reactionTable[side][a][b] = (Reaction){0, (unsigned char)a, (unsigned char)b, false};
+            }
+        }
+    }
+    for (int a = 0; a < MATERIAL_COUNT; a++) {
+        hasReactions[a] = false;
+        reactionPartners[a] = 0;
     }
 
-    int otherDir = -dir;
-    if (x + otherDir >= 0 && x + otherDir < gridWidth && y + 1 < gridHeight && (grid[y + 1][x + otherDir] == EMPTY || grid[y + 1][x + otherDir] == GAS || grid[y + 1][x + otherDir] == ACID_GAS)) {
-        int temp = grid[y + 1][x + otherDir];
-        grid[y + 1][x + otherDir] = WATER;
-        grid[y][x] = temp;
-        return true;
+    for (int i = 0; i < reactionRuleCount; i++) {
+        ReactionRule* rule = &reactionRules[i];
+        for (int side = 0; side < 4; side++) {
+            if (rule->sides & (1 << side)) {
+                reactionTable[side][rule->a][rule->b] = (Reaction){
+                    (unsigned int)(rule->probability * 2147483648.0),
+                    (unsigned char)rule->resultA,
+                    (unsigned char)rule->resultB,
+                    rule->stop
+                };
+            }
+        }
+        hasReactions[rule->a] = true;
+        reactionPartners[rule->a] |= 1u << rule->b;
     }
+}
 
-    if (x + dir >= 0 && x + dir < gridWidth && (grid[y][x + dir] == EMPTY || grid[y][x + dir] == GAS || grid[y][x + dir] == ACID_GAS)) {
-        int temp = grid[y][x + dir];
-        grid[y][x + dir] = WATER;
-        grid[y][x] = temp;
-        return true;
+// Update kernels. Each kernel takes a `checked` flag that is always a constant
+// at the call site: stepInteriorCell instantiates them with checked == false
+// for cells at least one cell away from the border, where no neighbour access
+// can leave the grid, and stepEdgeCell with checked == true for the outer ring.
+// Forced inlining lets the compiler drop the bounds tests from the interior copy
+// and fold the material traits below into the displacement tests.
+#define KERNEL static inline __attribute__((always_inline))
+
+#define BIT(material) (1u << (material))
+
+// What a moving material may swap places with, per direction of movement
+typedef struct {
+    unsigned int fall;      // Straight down
+    unsigned int slide;     // Diagonally down
+    unsigned int flow;      // Sideways
+} MaterialTraits;
+
+const MaterialTraits materialTraits[MATERIAL_COUNT] = {
+    [SAND]       = { BIT(EMPTY) | BIT(WATER) | BIT(GAS) | BIT(ACID_GAS), BIT(EMPTY), 0 },
+    [DIRT]       = { BIT(EMPTY) | BIT(WATER) | BIT(GAS) | BIT(ACID_GAS), BIT(EMPTY), 0 },
+    [WATER]      = { BIT(EMPTY) | BIT(GAS) | BIT(ACID_GAS),
+                     BIT(EMPTY) | BIT(GAS) | BIT(ACID_GAS),
+                     BIT(EMPTY) | BIT(GAS) | BIT(ACID_GAS) },
+    [ACID]       = { BIT(EMPTY) | BIT(WATER) | BIT(STONE),
+                     BIT(EMPTY) | BIT(WATER) | BIT(STONE),
+                     BIT(EMPTY) | BIT(WATER) | BIT(STONE) },
+    [GRASS_SEED] = { BIT(EMPTY) | BIT(WATER) | BIT(GAS) | BIT(ACID_GAS), 0, 0 },
+};
+
+KERNEL bool inGrid(bool checked, int gridHeight, int gridWidth, int x, int y) {
+    return !checked || (x >= 0 && x < gridWidth && y >= 0 && y < gridHeight);
+}
+
+KERNEL bool displaces(unsigned int mask, int material) {
+    return (mask >> material) & 1;
+}
+
+KERNEL void swapCells(int** grid, int x, int y, int nx, int ny) {
+    int temp = grid[ny][nx];
+    grid[ny][nx] = grid[y][x];
+    grid[y][x] = temp;
+}
+
+// Resets a cell's timers for its new material; a cell turned into gas holds a full unit of it
+void clearCellTimers(int*** timerPlanes, int x, int y, int material) {
+    for (int i = 0; i < TIMER_PLANE_COUNT; i++) {
+        timerPlanes[i][y][x] = 0;
     }
+    if (material == GAS) {
+        timerPlanes[PLANE_GAS_DENSITY][y][x] = GAS_UNIT;
+    } else if (material == ACID_GAS) {
+        timerPlanes[PLANE_ACID_GAS_DENSITY][y][x] = GAS_UNIT;
+    }
+}
 
-    if (x + otherDir >= 0 && x + otherDir < gridWidth && (grid[y][x + otherDir] == EMPTY || grid[y][x + otherDir] == GAS || grid[y][x + otherDir] == ACID_GAS)) {
-        int temp = grid[y][x + otherDir];
-        grid[y][x + otherDir] = WATER;
-        grid[y][x] = temp;
-        return true;
+// Set when a reaction rewrites a neighbour's material; the stepper clears it
+// before each cell. Thread-local like rngState, for batch workers.
+_Thread_local bool neighbourRewritten = false;
+
+// Runs the reaction table against the four neighbours of (x, y), below, right,
+// above, then left. Returns true when the cell itself changed material or a
+// stopping reaction fired, either of which ends the cell's turn.
+KERNEL bool applyReactions(bool checked, int gridHeight, int gridWidth, int** grid, int*** timerPlanes, int x, int y) {
+    int a = grid[y][x];
+    if (!hasReactions[a]) {
+        return false;
     }
 
-    return false;
-}
+    // Most cells, such as gas away from any flame, have no neighbour they can react with
+    unsigned int neighbours = 0;
+    for (int side = 0; side < 4; side++) {
+        int nx = x + sideOffsets[side][0];
+        int ny = y + sideOffsets[side][1];
+        if (inGrid(checked, gridHeight, gridWidth, nx, ny)) {
+            neighbours |= BIT(grid[ny][nx]);
+        }
+    }
+    if (!(neighbours & reactionPartners[a])) {
+        return false;
+    }
+
+    for (int side = 0; side < 4; side++) {
+        int nx = x + sideOffsets[side][0];
+        int ny = y + sideOffsets[side][1];
+        if (!inGrid(checked, gridHeight, gridWidth, nx, ny)) {
+            continue;
+        }
 
-float findNearestAcidDistance(int gridHeight, int gridWidth, int** grid, int x, int y) {
-    float minDistance = INFINITY;
+        int b = grid[ny][nx];
+        const Reaction* reaction = &reactionTable[side][a][b];
+        bool fires = (fastRandom() >> 1) < reaction->threshold;
+        int newA = fires ? reaction->resultA : a;
+        int newB = fires ? reaction->resultB : b;
+        grid[y][x] = newA;
+        grid[ny][nx] = newB;
 
-    for (int ay = 0; ay < gridHeight; ay++) {
-        for (int ax = 0; ax < gridWidth; ax++) {
-            if (grid[ay][ax] == ACID) {
-                float dist = sqrtf((ax - x) * (ax - x) + (ay - y) * (ay - y));
-                if (dist < minDistance) {
-                    minDistance = dist;
-                }
-            }
+        if (newB != b) {
+            clearCellTimers(timerPlanes, nx, ny, newB);
+            neighbourRewritten = true;
+        }
+        if (newA != a) {
+            clearCellTimers(timerPlanes, x, y, newA);
+            return true;
+        }
+        if (fires && reaction->stop) {
+            return true;
         }
     }
 
-    return minDistance;
+    return false;
 }
 
-bool updateAcid(int gridHeight, int gridWidth, int** grid,
-                int** acidStage, int** acidTimer, int** acidGasCooldown,
-                int x, int y) {
-    acidTimer[y][x]++;
+// Physics functions
+
+// Falls straight down, then slides diagonally, then flows sideways, swapping
+// with whatever the element's traits allow in each direction
+KERNEL bool updateFalling(bool checked, int gridHeight, int gridWidth, int** grid, int x, int y, int element) {
+    const MaterialTraits* traits = &materialTraits[element];
+
+    if (inGrid(checked, gridHeight, gridWidth, x, y + 1) && displaces(traits->fall, grid[y + 1][x])) {
+        swapCells(grid, x, y, x, y + 1);
+        return true;
+    }
+
+    if (!traits->slide && !traits->flow) {
+        return false;
+    }
 
-    if (GetRandomValue(0, 100) < 2 && acidTimer[y][x] > 300) {
-        if (grid[y][x] == ACID) {
-            grid[y][x] = ACID_GAS;
-            acidTimer[y][x] = GetRandomValue(60, 180);
-            acidStage[y][x] = GetRandomValue(0, 2);
-            acidGasCooldown[y][x] = 10;
+    int dir = (randomRange(0, 1) == 0) ? -1 : 1;
+    for (int i = 0; i < 2; i++, dir = -dir) {
+        if (inGrid(checked, gridHeight, gridWidth, x + dir, y + 1) && displaces(traits->slide, grid[y + 1][x + dir])) {
+            swapCells(grid, x, y, x + dir, y + 1);
             return true;
         }
     }
 
-    int dirs[4][2] = {{0, 1}, {1, 0}, {0, -1}, {-1, 0}};
-    for (int i = 0; i < 4; i++) {
-        int nx = x + dirs[i][0];
-        int ny = y + dirs[i][1];
-        if (nx >= 0 && nx < gridWidth && ny >= 0 && ny < gridHeight &&
-            (grid[ny][nx] == SAND || grid[ny][nx] == STONE)) {
-            grid[ny][nx] = EMPTY;
+    for (int i = 0; i < 2; i++, dir = -dir) {
+        if (inGrid(checked, gridHeight, gridWidth, x + dir, y) && displaces(traits->flow, grid[y][x + dir])) {
+            swapCells(grid, x, y, x + dir, y);
             return true;
         }
     }
 
+    return false;
+}
+
+KERNEL bool updateSand(bool checked, int gridHeight, int gridWidth, int** grid, int x, int y) {
+    return updateFalling(checked, gridHeight, gridWidth, grid, x, y, SAND);
+}
+
+KERNEL bool updateDirt(bool checked, int gridHeight, int gridWidth, int** grid, int x, int y) {
+    return updateFalling(checked, gridHeight, gridWidth, grid, x, y, DIRT);
+}
+
+KERNEL bool updateWater(bool checked, int gridHeight, int gridWidth, int** grid, int x, int y) {
+    if (inGrid(checked, gridHeight, gridWidth, x, y - 1) && grid[y - 1][x] == SAND) {
+        swapCells(grid, x, y, x, y - 1);
+        return true;
+    }
+
+    return updateFalling(checked, gridHeight, gridWidth, grid, x, y, WATER);
+}
+
+// Acid moves into its target and destroys it, carrying its timer along
+KERNEL void moveAcid(int** grid, int** acidStage, int** acidTimer, int x, int y, int nx, int ny) {
+    grid[ny][nx] = ACID;
+    acidStage[ny][nx] = 0;
+    acidTimer[ny][nx] = acidTimer[y][x];
+    grid[y][x] = EMPTY;
+    acidStage[y][x] = 0;
+    acidTimer[y][x] = 0;
+}
+
+// Acid ages every tick and, once old, may turn to gas. This runs before the
+// reaction pass, so acid that spends its turn dissolving a neighbour still ages.
+KERNEL bool ageAcid(int** grid, int** acidStage, int** acidTimer, int** acidGasDensity, int x, int y) {
+    acidTimer[y][x]++;
+
+    if (randomRange(0, 100) < 2 && acidTimer[y][x] > 300) {
+        grid[y][x] = ACID_GAS;
+        acidTimer[y][x] = 0;
+        acidStage[y][x] = 0;
+        acidGasDensity[y][x] = GAS_UNIT;
+        return true;
+    }
+    return false;
+}
+
+KERNEL bool updateAcid(bool checked, int gridHeight, int gridWidth, int** grid,
+                       int** acidStage, int** acidTimer, int x, int y) {
+    const MaterialTraits* traits = &materialTraits[ACID];
+
     // Convert adjacent water to acid with gradual color change
     for (int i = 0; i < 4; i++) {
-        int nx = x + dirs[i][0];
-        int ny = y + dirs[i][1];
-        if (nx >= 0 && nx < gridWidth && ny >= 0 && ny < gridHeight && grid[ny][nx] == WATER) {
-            float dist = findNearestAcidDistance(gridHeight, gridWidth, grid, nx, ny);
-            int conversionRate = (int)(30.0f / (1.0f + dist));
-            
-            if (GetRandomValue(0, conversionRate) == 0) {
+        int nx = x + sideOffsets[i][0];
+        int ny = y + sideOffsets[i][1];
+        if (inGrid(checked, gridHeight, gridWidth, nx, ny) && grid[ny][nx] == WATER) {
+            // 30 / (1 + distance to the nearest acid), and the nearest acid is this cell
+            const int conversionRate = 15;
+
+            if (randomRange(0, conversionRate) == 0) {
                 if (acidStage[ny][nx] < 4) {
                     acidStage[ny][nx]++;
                     return true;
@@ -203,359 +524,2989 @@ bool updateAcid(int gridHeight, int gridWidth, int** grid,
         }
     }
 
-    if (y + 1 < gridHeight && (grid[y + 1][x] == EMPTY || grid[y + 1][x] == WATER || grid[y + 1][x] == STONE)) {
-        grid[y + 1][x] = ACID;
-        acidStage[y + 1][x] = 0;
-        acidTimer[y + 1][x] = acidTimer[y][x];
-        grid[y][x] = EMPTY;
-        acidStage[y][x] = 0;
-        acidTimer[y][x] = 0;
+    if (inGrid(checked, gridHeight, gridWidth, x, y + 1) && displaces(traits->fall, grid[y + 1][x])) {
+        moveAcid(grid, acidStage, acidTimer, x, y, x, y + 1);
         return true;
     }
 
-    int dir = (GetRandomValue(0, 1) == 0) ? -1 : 1;
-    if (x + dir >= 0 && x + dir < gridWidth && y + 1 < gridHeight &&
-        (grid[y + 1][x + dir] == EMPTY || grid[y + 1][x + dir] == WATER || grid[y + 1][x + dir] == STONE)) {
-        grid[y + 1][x + dir] = ACID;
-        acidStage[y + 1][x + dir] = 0;
-        acidTimer[y + 1][x + dir] = acidTimer[y][x];
+    int dir = (randomRange(0, 1) == 0) ? -1 : 1;
+    for (int i = 0; i < 2; i++, dir = -dir) {
+        if (inGrid(checked, gridHeight, gridWidth, x + dir, y + 1) && displaces(traits->slide, grid[y + 1][x + dir])) {
+            moveAcid(grid, acidStage, acidTimer, x, y, x + dir, y + 1);
+            return true;
+        }
+    }
+
+    for (int i = 0; i < 2; i++, dir = -dir) {
+        if (inGrid(checked, gridHeight, gridWidth, x + dir, y) && displaces(traits->flow, grid[y][x + dir])) {
+            moveAcid(grid, acidStage, acidTimer, x, y, x + dir, y);
+            return true;
+        }
+    }
+
+    if (acidTimer[y][x] > 1200) {
         grid[y][x] = EMPTY;
         acidStage[y][x] = 0;
         acidTimer[y][x] = 0;
         return true;
     }
 
-    int otherDir = -dir;
-    if (x + otherDir >= 0 && x + otherDir < gridWidth && y + 1 < gridHeight &&
-        (grid[y + 1][x + otherDir] == EMPTY || grid[y + 1][x + otherDir] == WATER || grid[y + 1][x + otherDir] == STONE)) {
-        grid[y + 1][x + otherDir] = ACID;
-        acidStage[y + 1][x + otherDir] = 0;
-        acidTimer[y + 1][x + otherDir] = acidTimer[y][x];
+    return false;
+}
+
+KERNEL bool updateFire(bool checked, int gridHeight, int gridWidth, int** grid, int** fireTimer, int x, int y) {
+    fireTimer[y][x]++;
+
+    if (randomRange(0, 100) < 50) {
+        int moveX = x + randomRange(-1, 1);
+        int moveY = y - 1;
+
+        if (inGrid(checked, gridHeight, gridWidth, moveX, moveY)) {
+            if (grid[moveY][moveX] == EMPTY) {
+                grid[moveY][moveX] = FIRE;
+                fireTimer[moveY][moveX] = fireTimer[y][x];
+                grid[y][x] = EMPTY;
+                fireTimer[y][x] = 0;
+                return true;
+            }
+        }
+    }
+
+    if (fireTimer[y][x] > 30) {
         grid[y][x] = EMPTY;
-        acidStage[y][x] = 0;
-        acidTimer[y][x] = 0;
+        fireTimer[y][x] = 0;
         return true;
     }
 
-    if (x + dir >= 0 && x + dir < gridWidth &&
-        (grid[y][x + dir] == EMPTY || grid[y][x + dir] == WATER || grid[y][x + dir] == STONE)) {
-        grid[y][x + dir] = ACID;
-        acidStage[y][x + dir] = 0;
-        acidTimer[y][x + dir] = acidTimer[y][x];
+    return false;
+}
+
+KERNEL bool updateSteam(bool checked, int gridHeight, int gridWidth, int** grid, int** steamTimer,
+                        int originY, int worldHeight, int x, int y) {
+    steamTimer[y][x]++;
+
+    if (steamTimer[y][x] > 1000 && steamTimer[y][x] < 1100 &&
+        y + originY < worldHeight/2 && randomRange(0, 100) < 2) {
+        if (inGrid(checked, gridHeight, gridWidth, x, y+1) && grid[y+1][x] == EMPTY) {
+            grid[y+1][x] = RAIN;
+            return true;
+        }
+    }
+
+    int riseChance = 70;
+    if (randomRange(0, 100) < riseChance && inGrid(checked, gridHeight, gridWidth, x, y - 1)) {
+        int dir = randomRange(0, 2) - 1;
+        int newX = x + dir;
+        int newY = y - 1;
+
+        if (inGrid(checked, gridHeight, gridWidth, newX, newY)) {
+            if (grid[newY][newX] == EMPTY || grid[newY][newX] == WATER) {
+                int targetMaterial = grid[newY][newX];
+                grid[newY][newX] = STEAM;
+                steamTimer[newY][newX] = steamTimer[y][x];
+
+                grid[y][x] = targetMaterial;
+                steamTimer[y][x] = 0;
+                return true;
+            }
+        }
+    }
+
+    if (randomRange(0, 100) < 40) {
+        int dir = (randomRange(0, 1) == 0) ? -1 : 1;
+        int newX = x + dir;
+
+        if (inGrid(checked, gridHeight, gridWidth, newX, y)) {
+            if (grid[y][newX] == EMPTY || grid[y][newX] == WATER) {
+                int targetMaterial = grid[y][newX];
+                grid[y][newX] = STEAM;
+                steamTimer[y][newX] = steamTimer[y][x];
+
+                grid[y][x] = targetMaterial;
+                steamTimer[y][x] = 0;
+                return true;
+            }
+        }
+    }
+
+    if (steamTimer[y][x] > 1100) {
         grid[y][x] = EMPTY;
-        acidStage[y][x] = 0;
-        acidTimer[y][x] = 0;
+        steamTimer[y][x] = 0;
         return true;
     }
 
-    if (x + otherDir >= 0 && x + otherDir < gridWidth &&
-        (grid[y][x + otherDir] == EMPTY || grid[y][x + otherDir] == WATER || grid[y][x + otherDir] == STONE)) {
-        grid[y][x + otherDir] = ACID;
-        acidStage[y][x + otherDir] = 0;
-        acidTimer[y][x + otherDir] = acidTimer[y][x];
-        grid[y][x] = EMPTY;
-        acidStage[y][x] = 0;
-        acidTimer[y][x] = 0;
+    return false;
+}
+
+KERNEL bool updateRain(bool checked, int gridHeight, int gridWidth, int** grid, int x, int y) {
+    if (inGrid(checked, gridHeight, gridWidth, x, y+1)) {
+        if (grid[y+1][x] == EMPTY) {
+            grid[y+1][x] = RAIN;
+            grid[y][x] = EMPTY;
+            return true;
+        }
+        else if (grid[y+1][x] != RAIN) {
+            grid[y][x] = WATER;
+            return true;
+        }
+    }
+    else {
+        grid[y][x] = WATER;
         return true;
     }
 
-    if (acidTimer[y][x] > 1200) {
-        grid[y][x] = EMPTY;
-        acidStage[y][x] = 0;
-        acidTimer[y][x] = 0;
+    return false;
+}
+
+KERNEL bool updateGrassSeed(bool checked, int gridHeight, int gridWidth, int** grid, int x, int y) {
+    // Falling behavior
+    return updateFalling(checked, gridHeight, gridWidth, grid, x, y, GRASS_SEED);
+}
+
+// Plants: a grass root (a GRASS cell resting on DIRT) grows once every
+// GROWTH_INTERVAL ticks, or every half interval if it has water beside it when it
+// starts waiting. Each growth event adds a cell to the top of its blade or, once
+// the blade is full grown, roots a new plant next to it. Events are rationed by a
+// per-tick budget spent in scan order, so a meadow costs at most GROWTH_BUDGET
+// events a tick; roots that miss out stay due and retry next tick. A blade cut
+// from its root withers back to seeds.
+#define GROWTH_BUDGET 64
+#define GROWTH_RESERVE (GROWTH_BUDGET / 2)
+#define GROWTH_WINDOW_ROWS 32
+#define GROWTH_INTERVAL 60
+#define MAX_BLADE_HEIGHT 6
+
+// Roots spend the budget in scan order, bottom up. So that roots higher up are not
+// starved by those below, GROWTH_RESERVE of it is held for a window of rows that
+// moves up the world one window per tick; roots outside it stop at that floor.
+// The window depends only on the tick and the world row, so every band agrees.
+int rowGrowthFloor(long tick, int worldY, int worldHeight) {
+    int windows = (worldHeight + GROWTH_WINDOW_ROWS - 1) / GROWTH_WINDOW_ROWS;
+    return (worldY / GROWTH_WINDOW_ROWS == tick % windows) ? 0 : GROWTH_RESERVE;
+}
+
+// A root's growth timer holds the tick it is next due, modulo 2^32 so that it fits
+// the plane, or 0 while it has not been scheduled. Waiting roots need no visits.
+int ticksUntilDue(int timer, long tick) {
+    return (int)((unsigned int)timer - (unsigned int)tick);
+}
+
+KERNEL void scheduleGrowth(bool checked, int gridHeight, int gridWidth, int** grid, int** growthTimer,
+                           long tick, int x, int y) {
+    bool watered = false;
+    for (int i = 0; i < 4; i++) {
+        int nx = x + sideOffsets[i][0];
+        int ny = y + sideOffsets[i][1];
+        if (inGrid(checked, gridHeight, gridWidth, nx, ny) && grid[ny][nx] == WATER) {
+            watered = true;
+        }
+    }
+    unsigned int due = (unsigned int)tick + (watered ? GROWTH_INTERVAL / 2 : GROWTH_INTERVAL);
+    growthTimer[y][x] = due ? (int)due : 1;
+}
+
+// One growth event for a due root; false if it has no room
+KERNEL bool growPlant(bool checked, int gridHeight, int gridWidth, int** grid, int** growthTimer, int x, int y) {
+    int top = y - 1;
+    int height = 0;
+    while (height < MAX_BLADE_HEIGHT && top >= 0 && grid[top][x] == GRASS) {
+        height++;
+        top--;
+    }
+
+    if (height < MAX_BLADE_HEIGHT) {
+        if (top < 0 || grid[top][x] != EMPTY) {
+            return false;
+        }
+        grid[top][x] = GRASS;
+        growthTimer[top][x] = 0;
         return true;
     }
 
+    int dir = (randomRange(0, 1) == 0) ? -1 : 1;
+    for (int i = 0; i < 2; i++, dir = -dir) {
+        if (inGrid(checked, gridHeight, gridWidth, x + dir, y) && grid[y][x + dir] == EMPTY &&
+            grid[y + 1][x + dir] == DIRT) {
+            grid[y][x + dir] = GRASS;
+            growthTimer[y][x + dir] = 0;
+            return true;
+        }
+    }
     return false;
 }
 
-bool updateAcidGas(int gridHeight, int gridWidth, int** grid,
-                   int** acidTimer, int** acidStage, int** acidGasCooldown,
-                   int x, int y) {
-    acidTimer[y][x]--;
+// Lowers *growthDue to the tick this cell next needs a turn. A due root that finds
+// no room to grow waits a full interval before trying again.
+KERNEL bool updateGrass(bool checked, int gridHeight, int gridWidth, int** grid, int** growthTimer,
+                        int* growthBudget, int growthFloor, long tick, long* growthDue, int x, int y) {
+    if (!inGrid(checked, gridHeight, gridWidth, x, y + 1) || grid[y + 1][x] != DIRT) {
+        if (inGrid(checked, gridHeight, gridWidth, x, y + 1) && grid[y + 1][x] == GRASS) {
+            return false;
+        }
+        if (*growthDue > tick + 1) {
+            *growthDue = tick + 1;
+        }
+        if (randomRange(0, 30) == 0) {
+            grid[y][x] = GRASS_SEED;
+            return true;
+        }
+        return false;
+    }
+
+    bool grew = false;
+    if (growthTimer[y][x] == 0) {
+        scheduleGrowth(checked, gridHeight, gridWidth, grid, growthTimer, tick, x, y);
+    }
+    else if (ticksUntilDue(growthTimer[y][x], tick) <= 0 && *growthBudget > growthFloor) {
+        grew = growPlant(checked, gridHeight, gridWidth, grid, growthTimer, x, y);
+        *growthBudget -= grew;
+        scheduleGrowth(checked, gridHeight, gridWidth, grid, growthTimer, tick, x, y);
+    }
+
+    long due = tick + ticksUntilDue(growthTimer[y][x], tick);
+    if (*growthDue > due) {
+        *growthDue = due;
+    }
+    return grew;
+}
+
+// Materials stepCell has a rule for
+const bool hasUpdateRule[MATERIAL_COUNT] = {
+    [SAND] = true, [WATER] = true, [ACID] = true, [FIRE] = true, [STEAM] = true,
+    [RAIN] = true, [DIRT] = true, [GRASS_SEED] = true, [GRASS] = true
+};
+
+// Materials whose rule does nothing for as long as the cells below them stay as they
+// are, or for grass, until a plant is due
+const bool settles[MATERIAL_COUNT] = {
+    [SAND] = true, [DIRT] = true, [GRASS_SEED] = true, [GRASS] = true
+};
+
+// Reactions first, then the material's own rule; acid ages before either. Returns
+// true when the cell was updated.
+// GAS and ACID_GAS have no rule here: they move as concentrations in the gas field pass.
+// The grid may be a band of a larger world starting at world row originY.
+KERNEL bool stepCell(bool checked, int gridHeight, int gridWidth, int** grid, int*** timerPlanes,
+                     int originY, int worldHeight, int* growthBudget, int growthFloor,
+                     long tick, long* growthDue, int x, int y) {
+    int** acidStage = timerPlanes[PLANE_ACID_STAGE];
+    int** acidTimer = timerPlanes[PLANE_ACID_TIMER];
+    if (grid[y][x] == ACID &&
+        ageAcid(grid, acidStage, acidTimer, timerPlanes[PLANE_ACID_GAS_DENSITY], x, y)) {
+        return true;
+    }
+
+    if (applyReactions(checked, gridHeight, gridWidth, grid, timerPlanes, x, y)) {
+        return true;
+    }
+
+    switch (grid[y][x]) {
+        case SAND:
+            return updateSand(checked, gridHeight, gridWidth, grid, x, y);
+        case WATER:
+            return updateWater(checked, gridHeight, gridWidth, grid, x, y);
+        case ACID:
+            return updateAcid(checked, gridHeight, gridWidth, grid, acidStage, acidTimer, x, y);
+        case FIRE:
+            return updateFire(checked, gridHeight, gridWidth, grid, timerPlanes[PLANE_FIRE_TIMER], x, y);
+        case STEAM:
+            return updateSteam(checked, gridHeight, gridWidth, grid, timerPlanes[PLANE_STEAM_TIMER],
+                               originY, worldHeight, x, y);
+        case RAIN:
+            return updateRain(checked, gridHeight, gridWidth, grid, x, y);
+        case DIRT:
+            return updateDirt(checked, gridHeight, gridWidth, grid, x, y);
+        case GRASS_SEED:
+            return updateGrassSeed(checked, gridHeight, gridWidth, grid, x, y);
+        case GRASS:
+            return updateGrass(checked, gridHeight, gridWidth, grid, timerPlanes[PLANE_GROWTH_TIMER],
+                               growthBudget, growthFloor, tick, growthDue, x, y);
+        default:
+            return false;
+    }
+}
+
+bool stepInteriorCell(int gridHeight, int gridWidth, int** grid, int*** timerPlanes,
+                      int originY, int worldHeight, int* growthBudget, int growthFloor,
+                      long tick, long* growthDue, int x, int y) {
+    return stepCell(false, gridHeight, gridWidth, grid, timerPlanes, originY, worldHeight,
+                    growthBudget, growthFloor, tick, growthDue, x, y);
+}
+
+bool stepEdgeCell(int gridHeight, int gridWidth, int** grid, int*** timerPlanes,
+                  int originY, int worldHeight, int* growthBudget, int growthFloor,
+                  long tick, long* growthDue, int x, int y) {
+    return stepCell(true, gridHeight, gridWidth, grid, timerPlanes, originY, worldHeight,
+                    growthBudget, growthFloor, tick, growthDue, x, y);
+}
+
+// Colour lookup tables: every material's colour ramp indexed by its quantized
+// timer or stage, packed back to back in straight and black-composited forms.
+// Built once at startup so drawing a cell is a table gather, not float maths.
+#define GAS_COLOR_STEPS 256
+#define STEAM_FADE_TIME 1800
+#define COLOR_LUT_SIZE (MATERIAL_COUNT + 5 + EVAPORATION_TIME + 1 + GAS_COLOR_STEPS + 1 + 5 + \
+                        GAS_COLOR_STEPS + 1 + STEAM_FADE_TIME + 1)
+
+Color colorLut[COLOR_LUT_SIZE];
+Color displayLut[COLOR_LUT_SIZE];
+int colorLutOffset[MATERIAL_COUNT];
+int colorLutSize[MATERIAL_COUNT];
+
+// Colour of `material` at ramp position `key`, straight alpha
+Color rampColor(int material, int key) {
+    switch (material) {
+        case SAND:
+            return YELLOW;
+        case WATER:
+            if (key > 0) {
+                float blendRatio = (float)key / 4.0f;
+                return (Color){
+                    (unsigned char)(0 * (1.0f - blendRatio) + acidColors[key].r * blendRatio),
+                    (unsigned char)(105 * (1.0f - blendRatio) + acidColors[key].g * blendRatio),
+                    (unsigned char)(148 * (1.0f - blendRatio) + acidColors[key].b * blendRatio),
+                    200
+                };
+            }
+            return (Color){0, 105, 148, 200};
+        case STONE:
+            return DARKGRAY;
+        case ACID: {
+            float alpha = key > EVAPORATION_TIME * 0.8f ?
+                         200.0f * (1.0f - (key - EVAPORATION_TIME * 0.8f) / (EVAPORATION_TIME * 0.2f)) :
+                         200.0f;
+            Color acidColor = acidColors[0];
+            acidColor.a = alpha;
+            return acidColor;
+        }
+        case GAS: {
+            float alpha = 60.0f + 90.0f * (float)key / GAS_COLOR_STEPS;
+            return (Color){200, 200, 200, (unsigned char)alpha};
+        }
+        case FIRE:
+            return fireColors[key];
+        case ACID_GAS:
+            // Thin gas is light, dense gas dark
+            return acidGasColors[key * 3 / (GAS_COLOR_STEPS + 1)];
+        case STEAM: {
+            int colorIndex = key / 600;
+            if (colorIndex > 2) colorIndex = 2;
+            Color steamColor = steamColors[colorIndex];
+
+            float progress = (float)key / STEAM_FADE_TIME;
+            steamColor.a = 255 * (1.0f - progress * 0.7f);
+            return steamColor;
+        }
+        case RAIN:
+            return rainColor;
+        case DIRT:
+            return (Color){139, 69, 19, 255};  // Brown
+        case GRASS_SEED:
+            return (Color){205, 133, 63, 255}; // Light brown
+        case GRASS:
+            return (Color){0, 128, 0, 255};    // Green
+        default:
+            return (Color){0, 0, 0, 0};
+    }
+}
+
+void buildColorTables(void) {
+    int offset = 0;
+    for (int material = 0; material < MATERIAL_COUNT; material++) {
+        switch (material) {
+            case WATER: colorLutSize[material] = 5; break;
+            case ACID: colorLutSize[material] = EVAPORATION_TIME + 1; break;
+            case GAS: colorLutSize[material] = GAS_COLOR_STEPS + 1; break;
+            case FIRE: colorLutSize[material] = 5; break;
+            case ACID_GAS: colorLutSize[material] = GAS_COLOR_STEPS + 1; break;
+            case STEAM: colorLutSize[material] = STEAM_FADE_TIME + 1; break;
+            default: colorLutSize[material] = 1; break;
+        }
+        colorLutOffset[material] = offset;
+
+        for (int key = 0; key < colorLutSize[material]; key++) {
+            Color c = rampColor(material, key);
+            colorLut[offset + key] = c;
+            displayLut[offset + key] = (Color){
+                (unsigned char)(c.r * c.a / 255),
+                (unsigned char)(c.g * c.a / 255),
+                (unsigned char)(c.b * c.a / 255),
+                255
+            };
+        }
+        offset += colorLutSize[material];
+    }
+}
+
+// Position of cell (x, y) in the colour tables
+int colorLutIndex(int** grid, int*** timerPlanes, int x, int y) {
+    int material = grid[y][x];
+    int key = 0;
+    switch (material) {
+        case WATER:
+            key = timerPlanes[PLANE_ACID_STAGE][y][x];
+            break;
+        case ACID:
+            key = timerPlanes[PLANE_ACID_TIMER][y][x];
+            break;
+        case GAS:
+            key = timerPlanes[PLANE_GAS_DENSITY][y][x] / (GAS_UNIT / GAS_COLOR_STEPS);
+            break;
+        case FIRE:
+            key = (timerPlanes[PLANE_FIRE_TIMER][y][x] + x + y) % 5;
+            break;
+        case ACID_GAS:
+            key = timerPlanes[PLANE_ACID_GAS_DENSITY][y][x] / (GAS_UNIT / GAS_COLOR_STEPS);
+            break;
+        case STEAM:
+            key = timerPlanes[PLANE_STEAM_TIMER][y][x];
+            break;
+    }
+    if (key < 0) key = 0;
+    if (key >= colorLutSize[material]) key = colorLutSize[material] - 1;
+    return colorLutOffset[material] + key;
+}
+
+Color cellColor(int** grid, int*** timerPlanes, int x, int y) {
+    return colorLut[colorLutIndex(grid, timerPlanes, x, y)];
+}
+
+// Cell colour composited onto the black background, as an opaque colour
+Color cellDisplayColor(int** grid, int*** timerPlanes, int x, int y) {
+    return displayLut[colorLutIndex(grid, timerPlanes, x, y)];
+}
+
+Color averageColors(Color a, Color b, Color c, Color d) {
+    return (Color){
+        (unsigned char)((a.r + b.r + c.r + d.r) / 4),
+        (unsigned char)((a.g + b.g + c.g + d.g) / 4),
+        (unsigned char)((a.b + b.b + c.b + d.b) / 4),
+        255
+    };
+}
+
+// Marks every chunk overlapping the cell rectangle [x0, x1] x [y0, y1]
+void markChunksDirty(bool* chunkDirty, int chunksX, int chunksY, int x0, int y0, int x1, int y1) {
+    int cx0 = (x0 < 0 ? 0 : x0) / CHUNK_SIZE;
+    int cy0 = (y0 < 0 ? 0 : y0) / CHUNK_SIZE;
+    int cx1 = (x1 < 0 ? 0 : x1) / CHUNK_SIZE;
+    int cy1 = (y1 < 0 ? 0 : y1) / CHUNK_SIZE;
+    if (cx1 >= chunksX) cx1 = chunksX - 1;
+    if (cy1 >= chunksY) cy1 = chunksY - 1;
+
+    for (int cy = cy0; cy <= cy1; cy++) {
+        for (int cx = cx0; cx <= cx1; cx++) {
+            chunkDirty[cy * chunksX + cx] = true;
+        }
+    }
+}
+
+// Rebuilds levels 1..CHUNK_LOD_LEVELS of one chunk's colour pyramid
+void rebuildChunkLod(Color* lod, int gridHeight, int gridWidth, int** grid, int*** timerPlanes, int cx, int cy) {
+    int originX = cx * CHUNK_SIZE;
+    int originY = cy * CHUNK_SIZE;
+    int size = CHUNK_SIZE / 2;
+    Color black = {0, 0, 0, 255};
+
+    for (int ty = 0; ty < size; ty++) {
+        for (int tx = 0; tx < size; tx++) {
+            Color quad[4];
+            for (int i = 0; i < 4; i++) {
+                int x = originX + tx * 2 + (i & 1);
+                int y = originY + ty * 2 + (i >> 1);
+                quad[i] = (x < gridWidth && y < gridHeight) ? cellDisplayColor(grid, timerPlanes, x, y) : black;
+            }
+            lod[lodLevelOffsets[1] + ty * size + tx] = averageColors(quad[0], quad[1], quad[2], quad[3]);
+        }
+    }
+
+    for (int level = 2; level <= CHUNK_LOD_LEVELS; level++) {
+        Color* src = lod + lodLevelOffsets[level - 1];
+        Color* dst = lod + lodLevelOffsets[level];
+        int srcSize = size;
+        size /= 2;
+        for (int ty = 0; ty < size; ty++) {
+            for (int tx = 0; tx < size; tx++) {
+                dst[ty * size + tx] = averageColors(
+                    src[(ty * 2) * srcSize + tx * 2], src[(ty * 2) * srcSize + tx * 2 + 1],
+                    src[(ty * 2 + 1) * srcSize + tx * 2], src[(ty * 2 + 1) * srcSize + tx * 2 + 1]);
+            }
+        }
+    }
+}
+
+// Telemetry: the sim publishes counters into relaxed atomics as it runs, and an
+// optional server thread renders them as a Prometheus text page at
+// http://127.0.0.1:<port>/metrics. The sim never waits on the server.
+#define PHASE_STEP 0
+#define PHASE_EVAPORATION 1
+#define PHASE_GAS 2
+#define PHASE_CHECKPOINT 3
+#define PHASE_CAPTURE 4
+#define PHASE_RENDER 5
+#define PHASE_COUNT 6
+#define METRICS_PAGE_SIZE 8192
+#define METRICS_CLIENT_TIMEOUT_MS 500
+
+const char* phaseNames[PHASE_COUNT] = { "step", "evaporation", "gas", "checkpoint", "capture", "render" };
+
+typedef struct {
+    atomic_long ticks;
+    atomic_long phaseNanos[PHASE_COUNT];
+    atomic_long evaporated;
+    atomic_long growthEvents;
+    atomic_int activeChunks;        // Chunks marked changed in the last tick, each counted once
+    atomic_int chunkCount;
+    atomic_long arenaBytes;
+    atomic_long arenaUsed;
+    atomic_int captureQueued;       // Frames waiting for the encoder
+    atomic_long captureDropped;
+    atomic_long captureCoalesced;
+    atomic_long population[MATERIAL_COUNT];
+} Telemetry;
+
+Telemetry telemetry;
+
+typedef struct {
+    int listenFd;
+    atomic_bool running;
+    long lastTicks;                 // Tick count and time at the previous scrape, for ticks/sec
+    long lastNanos;
+    pthread_t thread;
+} MetricsServer;
+
+long nowNanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+void addPhaseTime(int phase, long startNanos) {
+    atomic_fetch_add_explicit(&telemetry.phaseNanos[phase], nowNanos() - startNanos, memory_order_relaxed);
+}
+
+long residentBytes(void) {
+    long pages = 0;
+    long resident = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file != NULL) {
+        if (fscanf(file, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(file);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+size_t formatMetrics(MetricsServer* server, char* page, size_t size) {
+    long ticks = atomic_load_explicit(&telemetry.ticks, memory_order_relaxed);
+    long now = nowNanos();
+    double ticksPerSecond = (now > server->lastNanos) ?
+                            (ticks - server->lastTicks) * 1e9 / (now - server->lastNanos) : 0.0;
+    server->lastTicks = ticks;
+    server->lastNanos = now;
+
+    size_t used = 0;
+#define EMIT(...) used += snprintf(page + used, used < size ? size - used : 0, __VA_ARGS__)
+    EMIT("# TYPE sim_ticks_total counter\nsim_ticks_total %ld\n", ticks);
+    EMIT("# TYPE sim_ticks_per_second gauge\nsim_ticks_per_second %.2f\n", ticksPerSecond);
+    EMIT("# TYPE sim_phase_seconds_total counter\n");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        EMIT("sim_phase_seconds_total{phase=\"%s\"} %.6f\n", phaseNames[i],
+             atomic_load_explicit(&telemetry.phaseNanos[i], memory_order_relaxed) / 1e9);
+    }
+    EMIT("# TYPE sim_active_chunks gauge\nsim_active_chunks %d\n",
+         atomic_load_explicit(&telemetry.activeChunks, memory_order_relaxed));
+    EMIT("# TYPE sim_chunks gauge\nsim_chunks %d\n",
+         atomic_load_explicit(&telemetry.chunkCount, memory_order_relaxed));
+    EMIT("# TYPE sim_cells gauge\n");
+    for (int i = 0; i < MATERIAL_COUNT; i++) {
+        EMIT("sim_cells{material=\"%s\"} %ld\n", materialNames[i],
+             atomic_load_explicit(&telemetry.population[i], memory_order_relaxed));
+    }
+    EMIT("# TYPE sim_memory_bytes gauge\n");
+    EMIT("sim_memory_bytes{kind=\"arena\"} %ld\n", atomic_load_explicit(&telemetry.arenaBytes, memory_order_relaxed));
+    EMIT("sim_memory_bytes{kind=\"arena_used\"} %ld\n", atomic_load_explicit(&telemetry.arenaUsed, memory_order_relaxed));
+    EMIT("sim_memory_bytes{kind=\"resident\"} %ld\n", residentBytes());
+    EMIT("# TYPE sim_growth_events_total counter\nsim_growth_events_total %ld\n",
+         atomic_load_explicit(&telemetry.growthEvents, memory_order_relaxed));
+    EMIT("# TYPE sim_evaporated_total counter\nsim_evaporated_total %ld\n",
+         atomic_load_explicit(&telemetry.evaporated, memory_order_relaxed));
+    EMIT("# TYPE sim_capture_queue_depth gauge\nsim_capture_queue_depth %d\n",
+         atomic_load_explicit(&telemetry.captureQueued, memory_order_relaxed));
+    EMIT("# TYPE sim_capture_dropped_total counter\nsim_capture_dropped_total %ld\n",
+         atomic_load_explicit(&telemetry.captureDropped, memory_order_relaxed));
+    EMIT("# TYPE sim_capture_coalesced_total counter\nsim_capture_coalesced_total %ld\n",
+         atomic_load_explicit(&telemetry.captureCoalesced, memory_order_relaxed));
+#undef EMIT
+    return used < size ? used : size - 1;
+}
+
+// Writes a reply without raising SIGPIPE if the scraper has already hung up
+void sendReply(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent <= 0) return;
+        data += sent;
+        size -= sent;
+    }
+}
+
+void* metricsThread(void* arg) {
+    MetricsServer* server = (MetricsServer*)arg;
+    char* page = (char *)malloc(METRICS_PAGE_SIZE);
+    char request[1024];
+
+    while (atomic_load(&server->running)) {
+        struct pollfd listener = { server->listenFd, POLLIN, 0 };
+        if (poll(&listener, 1, 200) <= 0) {
+            continue;
+        }
+        int client = accept(server->listenFd, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+
+        // A client that stalls is dropped after a short wait rather than holding up
+        // other scrapes and shutdown
+        struct timeval timeout = { 0, METRICS_CLIENT_TIMEOUT_MS * 1000 };
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        ssize_t length = read(client, request, sizeof(request) - 1);
+        request[length > 0 ? length : 0] = '\0';
+        if (strncmp(request, "GET /metrics ", 13) == 0) {
+            size_t size = formatMetrics(server, page, METRICS_PAGE_SIZE);
+            char header[128];
+            int headerSize = snprintf(header, sizeof(header),
+                                      "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                      "Content-Length: %zu\r\n\r\n", size);
+            sendReply(client, header, headerSize);
+            sendReply(client, page, size);
+        } else {
+            const char* notFound = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+            sendReply(client, notFound, strlen(notFound));
+        }
+        close(client);
+    }
+
+    free(page);
+    return NULL;
+}
+
+// Serves /metrics on 127.0.0.1:port from a background thread
+bool startMetricsServer(MetricsServer* server, int port) {
+    server->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server->listenFd < 0) {
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(server->listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((unsigned short)port);
+    if (bind(server->listenFd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(server->listenFd, 8) != 0) {
+        TraceLog(LOG_WARNING, "Cannot serve metrics on port %d", port);
+        close(server->listenFd);
+        return false;
+    }
+
+    server->lastTicks = atomic_load(&telemetry.ticks);
+    server->lastNanos = nowNanos();
+    atomic_store(&server->running, true);
+    pthread_create(&server->thread, NULL, metricsThread, server);
+    TraceLog(LOG_INFO, "Serving metrics on http://127.0.0.1:%d/metrics", port);
+    return true;
+}
+
+void stopMetricsServer(MetricsServer* server) {
+    atomic_store(&server->running, false);
+    pthread_join(server->thread, NULL);
+    close(server->listenFd);
+}
+
+// Time-lapse capture: the sim copies cell materials into a small ring of
+// preallocated slots at tick boundaries, and a background thread encodes them
+// to disk. A full ring never blocks the sim; the newest pending frame is
+// replaced instead (coalescing), or the frame is dropped if that slot is busy.
+#define CAPTURE_SLOTS 4
+#define SLOT_FREE 0
+#define SLOT_WRITING 1
+#define SLOT_READY 2
+#define SLOT_READING 3
+
+typedef struct {
+    atomic_int state;
+    long tick;
+    unsigned char* cells;
+} CaptureSlot;
+
+typedef struct {
+    FILE* file;
+    bool y4m;                   // YUV4MPEG2 video instead of the cell frame-delta format
+    int width;
+    int height;
+    CaptureSlot slots[CAPTURE_SLOTS];
+    long head;                  // Next slot the sim writes (sim thread only)
+    long tail;                  // Next slot the encoder reads (encoder thread only)
+    unsigned char* previous;    // Last encoded frame, for deltas
+    unsigned char* scratch;     // Encoder output buffer
+    atomic_bool running;
+    atomic_long dropped;
+    atomic_long coalesced;
+    pthread_t thread;
+} CaptureStream;
+
+// Palette used for captured frames: the display colour of each material with fresh timers
+Color capturePalette(int material) {
+    switch (material) {
+        case SAND: return YELLOW;
+        case WATER: return (Color){0, 105, 148, 200};
+        case STONE: return DARKGRAY;
+        case ACID: return acidColors[0];
+        case GAS: return (Color){200, 200, 200, 150};
+        case FIRE: return fireColors[0];
+        case ACID_GAS: return acidGasColors[0];
+        case STEAM: return steamColors[0];
+        case RAIN: return rainColor;
+        case DIRT: return (Color){139, 69, 19, 255};
+        case GRASS_SEED: return (Color){205, 133, 63, 255};
+        case GRASS: return (Color){0, 128, 0, 255};
+        default: return (Color){0, 0, 0, 0};
+    }
+}
+
+void storeU32(unsigned char* bytes, unsigned int value) {
+    bytes[0] = value & 0xFF;
+    bytes[1] = (value >> 8) & 0xFF;
+    bytes[2] = (value >> 16) & 0xFF;
+    bytes[3] = value >> 24;
+}
+
+unsigned int loadU32(const unsigned char* bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((unsigned int)bytes[3] << 24);
+}
+
+void writeU32(FILE* file, unsigned int value) {
+    unsigned char bytes[4];
+    storeU32(bytes, value);
+    fwrite(bytes, 1, 4, file);
+}
+
+// Run-length encodes `length` bytes as (count, value) pairs. `out` must hold 2 * length bytes.
+size_t encodeRuns(const unsigned char* data, size_t length, unsigned char* out) {
+    size_t written = 0;
+    size_t i = 0;
+    while (i < length) {
+        unsigned char value = data[i];
+        size_t run = 1;
+        while (i + run < length && run < 255 && data[i + run] == value) {
+            run++;
+        }
+        out[written++] = (unsigned char)run;
+        out[written++] = value;
+        i += run;
+    }
+    return written;
+}
+
+// Cell frame-delta frame: tick, payload size, then the run-length encoded XOR
+// of this frame against the previous one, so unchanged areas cost two bytes per 255 cells.
+void encodeDeltaFrame(CaptureStream* stream, const unsigned char* cells, long tick) {
+    size_t count = (size_t)stream->width * stream->height;
+    for (size_t i = 0; i < count; i++) {
+        stream->previous[i] ^= cells[i];
+    }
+    size_t size = encodeRuns(stream->previous, count, stream->scratch);
+    memcpy(stream->previous, cells, count);
+
+    writeU32(stream->file, (unsigned int)tick);
+    writeU32(stream->file, (unsigned int)size);
+    fwrite(stream->scratch, 1, size, stream->file);
+}
+
+// 4:4:4 YUV4MPEG2 frame using BT.601 coefficients
+void encodeY4mFrame(CaptureStream* stream, const unsigned char* cells) {
+    size_t count = (size_t)stream->width * stream->height;
+    unsigned char* y = stream->scratch;
+    unsigned char* u = y + count;
+    unsigned char* v = u + count;
+
+    for (size_t i = 0; i < count; i++) {
+        Color c = capturePalette(cells[i]);
+        float r = c.r * c.a / 255.0f;
+        float g = c.g * c.a / 255.0f;
+        float b = c.b * c.a / 255.0f;
+        y[i] = (unsigned char)(16.0f + 0.257f * r + 0.504f * g + 0.098f * b);
+        u[i] = (unsigned char)(128.0f - 0.148f * r - 0.291f * g + 0.439f * b);
+        v[i] = (unsigned char)(128.0f + 0.439f * r - 0.368f * g - 0.071f * b);
+    }
+
+    fputs("FRAME\n", stream->file);
+    fwrite(stream->scratch, 1, count * 3, stream->file);
+}
+
+void* captureThread(void* arg) {
+    CaptureStream* stream = (CaptureStream*)arg;
+    struct timespec idle = {0, 2000000};
+
+    while (true) {
+        CaptureSlot* slot = &stream->slots[stream->tail % CAPTURE_SLOTS];
+        int expected = SLOT_READY;
+        if (atomic_compare_exchange_strong(&slot->state, &expected, SLOT_READING)) {
+            if (stream->y4m) {
+                encodeY4mFrame(stream, slot->cells);
+            } else {
+                encodeDeltaFrame(stream, slot->cells, slot->tick);
+            }
+            atomic_store(&slot->state, SLOT_FREE);
+            stream->tail++;
+        } else if (!atomic_load(&stream->running) && expected != SLOT_WRITING) {
+            break;
+        } else {
+            nanosleep(&idle, NULL);
+        }
+    }
+
+    fflush(stream->file);
+    return NULL;
+}
+
+// Opens `path` and starts the encoder thread. Paths ending in ".y4m" produce
+// video, anything else the cell frame-delta format.
+bool startCapture(CaptureStream* stream, const char* path, int width, int height) {
+    memset(stream, 0, sizeof(*stream));
+    stream->file = fopen(path, "wb");
+    if (stream->file == NULL) {
+        TraceLog(LOG_WARNING, "Cannot open capture file %s", path);
+        return false;
+    }
+
+    size_t length = strlen(path);
+    stream->y4m = length > 4 && strcmp(path + length - 4, ".y4m") == 0;
+    stream->width = width;
+    stream->height = height;
+
+    size_t count = (size_t)width * height;
+    for (int i = 0; i < CAPTURE_SLOTS; i++) {
+        atomic_init(&stream->slots[i].state, SLOT_FREE);
+        stream->slots[i].cells = (unsigned char *)malloc(count);
+    }
+    stream->previous = (unsigned char *)calloc(count, 1);
+    stream->scratch = (unsigned char *)malloc(count * 3);
+    atomic_init(&stream->running, true);
+    atomic_init(&stream->dropped, 0);
+    atomic_init(&stream->coalesced, 0);
+
+    if (stream->y4m) {
+        fprintf(stream->file, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C444\n", width, height);
+    } else {
+        fwrite("CFD1", 1, 4, stream->file);
+        writeU32(stream->file, (unsigned int)width);
+        writeU32(stream->file, (unsigned int)height);
+    }
+
+    pthread_create(&stream->thread, NULL, captureThread, stream);
+    return true;
+}
+
+void copyCells(unsigned char* cells, int gridHeight, int gridWidth, int** grid) {
+    for (int y = 0; y < gridHeight; y++) {
+        for (int x = 0; x < gridWidth; x++) {
+            cells[y * gridWidth + x] = (unsigned char)grid[y][x];
+        }
+    }
+}
+
+// Publishes the ring's depth and loss counters to the metrics page
+void publishCaptureTelemetry(CaptureStream* stream) {
+    int queued = 0;
+    for (int i = 0; i < CAPTURE_SLOTS; i++) {
+        queued += atomic_load_explicit(&stream->slots[i].state, memory_order_relaxed) == SLOT_READY;
+    }
+    atomic_store_explicit(&telemetry.captureQueued, queued, memory_order_relaxed);
+    atomic_store_explicit(&telemetry.captureDropped, atomic_load(&stream->dropped), memory_order_relaxed);
+    atomic_store_explicit(&telemetry.captureCoalesced, atomic_load(&stream->coalesced), memory_order_relaxed);
+}
+
+// Called by the sim at a tick boundary; never waits on the encoder
+void captureFrame(CaptureStream* stream, int gridHeight, int gridWidth, int** grid, long tick) {
+    if (gridWidth != stream->width || gridHeight != stream->height) {
+        atomic_fetch_add(&stream->dropped, 1);
+        return;
+    }
+
+    CaptureSlot* slot = &stream->slots[stream->head % CAPTURE_SLOTS];
+    int expected = SLOT_FREE;
+    if (atomic_compare_exchange_strong(&slot->state, &expected, SLOT_WRITING)) {
+        copyCells(slot->cells, gridHeight, gridWidth, grid);
+        slot->tick = tick;
+        atomic_store(&slot->state, SLOT_READY);
+        stream->head++;
+        publishCaptureTelemetry(stream);
+        return;
+    }
+
+    // Ring is full: replace the newest pending frame if the encoder has not started on it
+    CaptureSlot* newest = &stream->slots[(stream->head + CAPTURE_SLOTS - 1) % CAPTURE_SLOTS];
+    expected = SLOT_READY;
+    if (stream->head > 0 && atomic_compare_exchange_strong(&newest->state, &expected, SLOT_WRITING)) {
+        copyCells(newest->cells, gridHeight, gridWidth, grid);
+        newest->tick = tick;
+        atomic_store(&newest->state, SLOT_READY);
+        atomic_fetch_add(&stream->coalesced, 1);
+    } else {
+        atomic_fetch_add(&stream->dropped, 1);
+    }
+    publishCaptureTelemetry(stream);
+}
+
+// Drains pending frames, stops the encoder and closes the file
+void stopCapture(CaptureStream* stream) {
+    atomic_store(&stream->running, false);
+    pthread_join(stream->thread, NULL);
+    fclose(stream->file);
+
+    for (int i = 0; i < CAPTURE_SLOTS; i++) {
+        free(stream->slots[i].cells);
+    }
+    free(stream->previous);
+    free(stream->scratch);
+
+    TraceLog(LOG_INFO, "Capture finished: %ld frames written, %ld coalesced, %ld dropped",
+             stream->tail, (long)atomic_load(&stream->coalesced), (long)atomic_load(&stream->dropped));
+}
+
+// Checkpoints: numbered files in a directory. A base file holds every chunk of
+// the grid and its timer planes; later files hold only chunks whose content
+// hash changed since the previous checkpoint. Only chunks the world marked as
+// written since then are hashed again. Restoring loads the newest base, overlays
+// the deltas written after it and checks every chunk against its stored hash.
+#define CHECKPOINT_PLANES (TIMER_PLANE_COUNT + 1)
+#define CHUNK_RAW_BYTES (CHECKPOINT_PLANES * CHUNK_SIZE * CHUNK_SIZE * 4)
+#define CHECKPOINT_COUNT_OFFSET 20
+#define RECORD_HEADER_BYTES 16
+
+typedef struct {
+    const char* dir;
+    int index;                  // Number of the next file to write
+    int width;
+    int height;
+    unsigned long long* hashes; // Per-chunk hash at the last checkpoint
+    unsigned char* raw;
+    unsigned char* packed;
+} CheckpointWriter;
+
+void checkpointPath(char* path, size_t size, const char* dir, int index) {
+    snprintf(path, size, "%s/checkpoint-%06d.ckpt", dir, index);
+}
+
+unsigned int readU32(FILE* file) {
+    unsigned char bytes[4] = {0, 0, 0, 0};
+    if (fread(bytes, 1, 4, file) != 4) {
+        return 0;
+    }
+    return loadU32(bytes);
+}
+
+// FNV-1a
+unsigned long long hashBytes(const unsigned char* data, size_t length) {
+    unsigned long long hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Bytes of one packed chunk; chunks on the right and bottom edges are cut short
+size_t chunkBytes(int gridHeight, int gridWidth, int cx, int cy) {
+    int rows = gridHeight - cy * CHUNK_SIZE < CHUNK_SIZE ? gridHeight - cy * CHUNK_SIZE : CHUNK_SIZE;
+    int columns = gridWidth - cx * CHUNK_SIZE < CHUNK_SIZE ? gridWidth - cx * CHUNK_SIZE : CHUNK_SIZE;
+    return (size_t)CHECKPOINT_PLANES * rows * columns * 4;
+}
+
+// Serializes one chunk of every plane as little-endian ints; returns the byte count.
+// The planes hold world rows from originY on, which must cover the chunk.
+size_t packChunk(unsigned char* raw, int gridHeight, int gridWidth, int*** planes, int originY, int cx, int cy) {
+    size_t size = 0;
+    for (int p = 0; p < CHECKPOINT_PLANES; p++) {
+        for (int y = cy * CHUNK_SIZE; y < (cy + 1) * CHUNK_SIZE && y < gridHeight; y++) {
+            for (int x = cx * CHUNK_SIZE; x < (cx + 1) * CHUNK_SIZE && x < gridWidth; x++) {
+                unsigned int value = (unsigned int)planes[p][y - originY][x];
+                raw[size++] = value & 0xFF;
+                raw[size++] = (value >> 8) & 0xFF;
+                raw[size++] = (value >> 16) & 0xFF;
+                raw[size++] = value >> 24;
+            }
+        }
+    }
+    return size;
+}
+
+// Stores the rows of a packed chunk that fall in the `rows` world rows from originY
+void unpackChunk(const unsigned char* raw, int gridHeight, int gridWidth, int*** planes, int originY, int rows,
+                 int cx, int cy) {
+    size_t offset = 0;
+    for (int p = 0; p < CHECKPOINT_PLANES; p++) {
+        for (int y = cy * CHUNK_SIZE; y < (cy + 1) * CHUNK_SIZE && y < gridHeight; y++) {
+            for (int x = cx * CHUNK_SIZE; x < (cx + 1) * CHUNK_SIZE && x < gridWidth; x++) {
+                if (y >= originY && y < originY + rows) {
+                    planes[p][y - originY][x] = (int)loadU32(raw + offset);
+                }
+                offset += 4;
+            }
+        }
+    }
+}
+
+size_t decodeRuns(const unsigned char* data, size_t length, unsigned char* out, size_t capacity) {
+    size_t written = 0;
+    for (size_t i = 0; i + 1 < length; i += 2) {
+        for (int run = 0; run < data[i] && written < capacity; run++) {
+            out[written++] = data[i + 1];
+        }
+    }
+    return written;
+}
+
+// Starts numbering after any checkpoints already in `dir`, so the first file written
+// is a new base. A writer with no directory only keeps the chunk hashes, for a band
+// of a multi-process run that hands its records to the band writing the files.
+void initCheckpoints(CheckpointWriter* writer, const char* dir) {
+    writer->dir = dir;
+    writer->index = 0;
+    writer->width = 0;
+    writer->height = 0;
+    writer->hashes = NULL;
+    writer->raw = (unsigned char *)malloc(CHUNK_RAW_BYTES);
+    writer->packed = (unsigned char *)malloc(CHUNK_RAW_BYTES * 2);
+    if (dir == NULL) {
+        return;
+    }
+    mkdir(dir, 0755);
+
+    char path[512];
+    while (true) {
+        checkpointPath(path, sizeof(path), dir, writer->index);
+        FILE* file = fopen(path, "rb");
+        if (file == NULL) break;
+        fclose(file);
+        writer->index++;
+    }
+}
+
+// True when the next checkpoint must be a base: the first one, or the first after a
+// resize or a failed write. A base starts the chunk hashes afresh.
+bool checkpointBase(CheckpointWriter* writer, int gridHeight, int gridWidth) {
+    if (writer->hashes != NULL && writer->width == gridWidth && writer->height == gridHeight) {
+        return false;
+    }
+    int chunksX = (gridWidth + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    int chunksY = (gridHeight + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    free(writer->hashes);
+    writer->hashes = (unsigned long long *)calloc(chunksX * chunksY, sizeof(unsigned long long));
+    writer->width = gridWidth;
+    writer->height = gridHeight;
+    return true;
+}
+
+// The file is written under a temporary name and renamed into place once complete,
+// so a run stopped part way never leaves a short checkpoint behind. Returns the open
+// file with its header written, or NULL if it cannot be created.
+FILE* beginCheckpoint(CheckpointWriter* writer, int gridHeight, int gridWidth, bool base, long tick) {
+    char path[512];
+    char partial[520];
+    checkpointPath(path, sizeof(path), writer->dir, writer->index);
+    snprintf(partial, sizeof(partial), "%s.tmp", path);
+    FILE* file = fopen(partial, "wb");
+    if (file == NULL) {
+        TraceLog(LOG_WARNING, "Cannot write checkpoint %s", path);
+        free(writer->hashes);
+        writer->hashes = NULL;
+        return NULL;
+    }
+
+    fwrite("CKP3", 1, 4, file);
+    writeU32(file, base ? 1 : 0);
+    writeU32(file, (unsigned int)gridWidth);
+    writeU32(file, (unsigned int)gridHeight);
+    writeU32(file, (unsigned int)tick);
+    writeU32(file, 0);
+    return file;
+}
+
+// Packs chunk (cx, cy) of planes holding world rows from originY as a record: its
+// index, hash and payload size go in `header` and the run-length encoded payload is
+// left in the writer's buffer. Returns the payload size, or 0 when the file is not a
+// base and the chunk is unchanged since the last checkpoint.
+size_t encodeRecord(CheckpointWriter* writer, int gridHeight, int gridWidth, int*** planes, int originY,
+                    int cx, int cy, bool base, unsigned char* header) {
+    int index = cy * ((gridWidth + CHUNK_SIZE - 1) / CHUNK_SIZE) + cx;
+    size_t size = packChunk(writer->raw, gridHeight, gridWidth, planes, originY, cx, cy);
+    unsigned long long hash = hashBytes(writer->raw, size);
+    if (!base && hash == writer->hashes[index]) {
+        return 0;
+    }
+    writer->hashes[index] = hash;
+
+    size_t packedSize = encodeRuns(writer->raw, size, writer->packed);
+    storeU32(header, (unsigned int)index);
+    storeU32(header + 4, (unsigned int)(hash & 0xFFFFFFFF));
+    storeU32(header + 8, (unsigned int)(hash >> 32));
+    storeU32(header + 12, (unsigned int)packedSize);
+    return packedSize;
+}
+
+// Stores the record count and renames the file into place; false if it could not be
+// written, in which case the next checkpoint is a base
+bool finishCheckpoint(CheckpointWriter* writer, FILE* file, unsigned int written) {
+    char path[512];
+    char partial[520];
+    checkpointPath(path, sizeof(path), writer->dir, writer->index);
+    snprintf(partial, sizeof(partial), "%s.tmp", path);
+
+    fseek(file, CHECKPOINT_COUNT_OFFSET, SEEK_SET);
+    writeU32(file, written);
+    bool failed = ferror(file) != 0;
+    failed |= fclose(file) != 0;
+    if (failed || rename(partial, path) != 0) {
+        // The stored hashes no longer describe any file on disk, so start over with a base
+        TraceLog(LOG_WARNING, "Cannot write checkpoint %s", path);
+        remove(partial);
+        free(writer->hashes);
+        writer->hashes = NULL;
+        return false;
+    }
+    writer->index++;
+    return true;
+}
+
+// Drops a checkpoint that could not be completed; the next one is a base
+void abandonCheckpoint(CheckpointWriter* writer, FILE* file) {
+    char path[512];
+    char partial[520];
+    checkpointPath(path, sizeof(path), writer->dir, writer->index);
+    snprintf(partial, sizeof(partial), "%s.tmp", path);
+    fclose(file);
+    remove(partial);
+    free(writer->hashes);
+    writer->hashes = NULL;
+}
+
+// `unsaved` flags the chunks that may have changed since the last checkpoint and is
+// cleared here; NULL hashes every chunk
+void writeCheckpoint(CheckpointWriter* writer, int gridHeight, int gridWidth, int*** planes, bool* unsaved,
+                     long tick) {
+    int chunksX = (gridWidth + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    int chunksY = (gridHeight + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    bool base = checkpointBase(writer, gridHeight, gridWidth);
+    FILE* file = beginCheckpoint(writer, gridHeight, gridWidth, base, tick);
+    if (file == NULL) {
+        return;
+    }
+
+    unsigned int written = 0;
+    for (int cy = 0; cy < chunksY; cy++) {
+        for (int cx = 0; cx < chunksX; cx++) {
+            if (!base && unsaved != NULL && !unsaved[cy * chunksX + cx]) {
+                continue;
+            }
+            unsigned char header[RECORD_HEADER_BYTES];
+            size_t size = encodeRecord(writer, gridHeight, gridWidth, planes, 0, cx, cy, base, header);
+            if (size > 0) {
+                fwrite(header, 1, RECORD_HEADER_BYTES, file);
+                fwrite(writer->packed, 1, size, file);
+                written++;
+            }
+        }
+    }
+
+    if (finishCheckpoint(writer, file, written) && unsaved != NULL) {
+        memset(unsaved, false, chunksX * chunksY * sizeof(bool));
+    }
+}
+
+void freeCheckpoints(CheckpointWriter* writer) {
+    free(writer->hashes);
+    free(writer->raw);
+    free(writer->packed);
+}
+
+// Finds the newest base checkpoint in `dir`; returns its number, or -1 if there is none
+int findCheckpointBase(const char* dir, int* width, int* height) {
+    int baseIndex = -1;
+    char path[512];
+    for (int index = 0; ; index++) {
+        checkpointPath(path, sizeof(path), dir, index);
+        FILE* file = fopen(path, "rb");
+        if (file == NULL) break;
+
+        char magic[4];
+        if (fread(magic, 1, 4, file) == 4 && memcmp(magic, "CKP3", 4) == 0 && readU32(file) == 1) {
+            *width = (int)readU32(file);
+            *height = (int)readU32(file);
+            baseIndex = index;
+        }
+        fclose(file);
+    }
+    return baseIndex;
+}
+
+// Loads base checkpoint `baseIndex` and overlays every delta after it into planes
+// holding the `rows` world rows from originY; chunks outside them are passed over.
+// Returns the restored tick, or -1 if a file is cut short, malformed or has a chunk
+// that does not match its stored hash.
+long restoreCheckpoints(const char* dir, int baseIndex, int gridHeight, int gridWidth, int*** planes,
+                        int originY, int rows) {
+    int chunksX = (gridWidth + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    unsigned int chunkCount = (unsigned int)(chunksX * ((gridHeight + CHUNK_SIZE - 1) / CHUNK_SIZE));
+    unsigned char* raw = (unsigned char *)malloc(CHUNK_RAW_BYTES);
+    unsigned char* packed = (unsigned char *)malloc(CHUNK_RAW_BYTES * 2);
+    long tick = 0;
+
+    char path[512];
+    for (int index = baseIndex; tick >= 0; index++) {
+        checkpointPath(path, sizeof(path), dir, index);
+        FILE* file = fopen(path, "rb");
+        if (file == NULL) break;
+
+        // readU32 reads 0 past the end, so every field is followed by a check for a short file
+        char magic[4];
+        bool valid = fread(magic, 1, 4, file) == 4 && memcmp(magic, "CKP3", 4) == 0;
+        bool base = readU32(file) == 1;
+        int width = (int)readU32(file);
+        int height = (int)readU32(file);
+        long fileTick = (long)readU32(file);
+        unsigned int count = readU32(file);
+        valid = valid && !feof(file) && base == (index == baseIndex) && width == gridWidth &&
+                height == gridHeight && count <= chunkCount;
+
+        for (unsigned int i = 0; valid && i < count; i++) {
+            unsigned int chunk = readU32(file);
+            unsigned long long hash = readU32(file);
+            hash |= (unsigned long long)readU32(file) << 32;
+            size_t size = readU32(file);
+            if (feof(file) || chunk >= chunkCount || size > CHUNK_RAW_BYTES * 2 ||
+                fread(packed, 1, size, file) != size) {
+                valid = false;
+                break;
+            }
+            int cx = (int)(chunk % chunksX);
+            int cy = (int)(chunk / chunksX);
+            if ((cy + 1) * CHUNK_SIZE <= originY || cy * CHUNK_SIZE >= originY + rows) {
+                continue;
+            }
+            size_t expected = chunkBytes(gridHeight, gridWidth, cx, cy);
+            if (decodeRuns(packed, size, raw, CHUNK_RAW_BYTES) != expected || hashBytes(raw, expected) != hash) {
+                valid = false;
+                break;
+            }
+            unpackChunk(raw, gridHeight, gridWidth, planes, originY, rows, cx, cy);
+        }
+        // The stored count must cover every record in the file
+        valid = valid && fgetc(file) == EOF;
+        fclose(file);
+
+        if (!valid) {
+            TraceLog(LOG_ERROR, "Checkpoint %s is damaged", path);
+            tick = -1;
+        } else {
+            tick = fileTick;
+        }
+    }
+
+    free(raw);
+    free(packed);
+    return tick;
+}
+
+// World storage: every per-cell plane, the row tables and the chunk metadata are
+// carved out of one arena mapped at startup (with huge pages when the system has
+// them). Clearing and resizing only reset the bump offset and carve again; the
+// arena is remapped only when a resize needs more space than it has.
+#define ARENA_ALIGNMENT 64
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+typedef struct {
+    unsigned char* memory;
+    size_t capacity;
+    size_t used;
+} WorldArena;
+
+typedef struct {
+    WorldArena arena;
+    int width;
+    int height;
+    int originY;                // World row of local row 0 when this is a band of a larger world
+    int worldHeight;
+    unsigned int seed;
+    bool publishes;             // Writes its counters to the metrics page
+    long tick;                  // Completed steps
+    int evaporationCounter;
+    int growthBudget;           // Plant growth events left this tick
+    int** grid;
+    int** timerPlanes[TIMER_PLANE_COUNT];
+    bool** updated;
+    int** gasScratch;           // Padded rows of old concentrations, open flags and chunk flags for the gas field
+    int chunksX;
+    int chunksY;
+    bool* chunkDirty;
+    bool* chunkChanged;         // Chunks written since their populations were last counted
+    int* chunkPopulation;       // Cells of each material, MATERIAL_COUNT entries per chunk
+    unsigned int* chunkMaterials; // Bit m set while the chunk holds material m
+    bool* chunkGas;             // Chunks the last gas pass left holding density
+    bool* chunkUnsaved;         // Chunks that may have been written since the last checkpoint
+    bool* chunkRecounted;       // Chunks recounted since the tick began
+    long* chunkDue;             // No settled cell in the chunk needs a turn before this tick
+    bool* chunkAwake;           // Chunks that were due when this tick began
+    long population[MATERIAL_COUNT];
+    Color* chunkLod;
+} World;
+
+bool arenaMap(WorldArena* arena, size_t capacity) {
+    capacity = (capacity + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    arena->used = 0;
+    arena->capacity = capacity;
+
+#ifdef MAP_HUGETLB
+    arena->memory = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (arena->memory != MAP_FAILED) {
+        return true;
+    }
+#endif
+
+    arena->memory = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (arena->memory == MAP_FAILED) {
+        arena->memory = NULL;
+        arena->capacity = 0;
+        return false;
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(arena->memory, capacity, MADV_HUGEPAGE);
+#endif
+    return true;
+}
+
+void arenaUnmap(WorldArena* arena) {
+    if (arena->memory != NULL) {
+        munmap(arena->memory, arena->capacity);
+    }
+    arena->memory = NULL;
+    arena->capacity = 0;
+    arena->used = 0;
+}
+
+void* arenaAlloc(WorldArena* arena, size_t size) {
+    size_t offset = (arena->used + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (offset + size > arena->capacity) {
+        return NULL;
+    }
+    arena->used = offset + size;
+    return arena->memory + offset;
+}
+
+size_t worldBytes(int width, int height) {
+    size_t cells = (size_t)width * height;
+    size_t chunks = (size_t)((width + CHUNK_SIZE - 1) / CHUNK_SIZE) * ((height + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    size_t planes = (1 + TIMER_PLANE_COUNT) * (cells * sizeof(int) + height * sizeof(int*) + 2 * ARENA_ALIGNMENT);
+    size_t flags = cells * sizeof(bool) + height * sizeof(bool*) + 2 * ARENA_ALIGNMENT;
+    size_t scratch = 13 * ((width + 2) * sizeof(int) + sizeof(int*)) + 2 * ARENA_ALIGNMENT;
+    size_t chunkData = chunks * (6 * sizeof(bool) + MATERIAL_COUNT * sizeof(int) + sizeof(unsigned int) +
+                                 sizeof(long) + CHUNK_LOD_TEXELS * sizeof(Color)) + 10 * ARENA_ALIGNMENT;
+    return planes + flags + scratch + chunkData;
+}
+
+// A zeroed width x height int plane with a row table, in one contiguous block
+int** carvePlane(WorldArena* arena, int width, int height) {
+    int** rows = (int **)arenaAlloc(arena, height * sizeof(int*));
+    int* cells = (int *)arenaAlloc(arena, (size_t)width * height * sizeof(int));
+    memset(cells, 0, (size_t)width * height * sizeof(int));
+    for (int y = 0; y < height; y++) {
+        rows[y] = cells + (size_t)y * width;
+    }
+    return rows;
+}
+
+void carveWorld(World* world, int width, int height) {
+    WorldArena* arena = &world->arena;
+    size_t needed = worldBytes(width, height);
+    if (needed > arena->capacity) {
+        arenaUnmap(arena);
+        if (!arenaMap(arena, needed)) {
+            TraceLog(LOG_ERROR, "Cannot map %zu bytes for a %dx%d world", needed, width, height);
+            exit(1);
+        }
+    }
+    arena->used = 0;
+
+    world->width = width;
+    world->height = height;
+    world->originY = 0;
+    world->worldHeight = height;
+    world->grid = carvePlane(arena, width, height);
+    for (int i = 0; i < TIMER_PLANE_COUNT; i++) {
+        world->timerPlanes[i] = carvePlane(arena, width, height);
+    }
+
+    world->updated = (bool **)arenaAlloc(arena, height * sizeof(bool*));
+    bool* flags = (bool *)arenaAlloc(arena, (size_t)width * height * sizeof(bool));
+    memset(flags, 0, (size_t)width * height * sizeof(bool));
+    for (int y = 0; y < height; y++) {
+        world->updated[y] = flags + (size_t)y * width;
+    }
+
+    world->gasScratch = carvePlane(arena, width + 2, 13);
+
+    world->chunksX = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    world->chunksY = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    int chunkCount = world->chunksX * world->chunksY;
+    world->chunkDirty = (bool *)arenaAlloc(arena, chunkCount * sizeof(bool));
+    world->chunkChanged = (bool *)arenaAlloc(arena, chunkCount * sizeof(bool));
+    world->chunkPopulation = (int *)arenaAlloc(arena, (size_t)chunkCount * MATERIAL_COUNT * sizeof(int));
+    world->chunkMaterials = (unsigned int *)arenaAlloc(arena, chunkCount * sizeof(unsigned int));
+    world->chunkGas = (bool *)arenaAlloc(arena, chunkCount * sizeof(bool));
+    world->chunkUnsaved = (bool *)arenaAlloc(arena, chunkCount * sizeof(bool));
+    world->chunkRecounted = (bool *)arenaAlloc(arena, chunkCount * sizeof(bool));
+    world->chunkDue = (long *)arenaAlloc(arena, chunkCount * sizeof(long));
+    world->chunkAwake = (bool *)arenaAlloc(arena, chunkCount * sizeof(bool));
+    world->chunkLod = (Color *)arenaAlloc(arena, (size_t)chunkCount * CHUNK_LOD_TEXELS * sizeof(Color));
+    memset(world->chunkDirty, true, chunkCount * sizeof(bool));
+
+    // Counts start at zero with every chunk due a recount and a visit, and gas
+    // assumed anywhere
+    memset(world->chunkChanged, true, chunkCount * sizeof(bool));
+    memset(world->chunkPopulation, 0, (size_t)chunkCount * MATERIAL_COUNT * sizeof(int));
+    memset(world->chunkMaterials, 0, chunkCount * sizeof(unsigned int));
+    memset(world->chunkGas, true, chunkCount * sizeof(bool));
+    memset(world->chunkUnsaved, true, chunkCount * sizeof(bool));
+    memset(world->chunkRecounted, false, chunkCount * sizeof(bool));
+    memset(world->chunkDue, 0, chunkCount * sizeof(long));
+    memset(world->chunkAwake, false, chunkCount * sizeof(bool));
+    memset(world->population, 0, sizeof(world->population));
+}
+
+void createWorld(World* world, int width, int height) {
+    memset(world, 0, sizeof(*world));
+    carveWorld(world, width, height);
+}
+
+// Marks chunks for redrawing, for recounting their populations and for the next
+// checkpoint; every write to the grid goes through here or through markAllChunksChanged
+void markChunksChanged(World* world, int x0, int y0, int x1, int y1) {
+    markChunksDirty(world->chunkDirty, world->chunksX, world->chunksY, x0, y0, x1, y1);
+    markChunksDirty(world->chunkChanged, world->chunksX, world->chunksY, x0, y0, x1, y1);
+    markChunksDirty(world->chunkUnsaved, world->chunksX, world->chunksY, x0, y0, x1, y1);
+}
+
+void markAllChunksChanged(World* world) {
+    memset(world->chunkDirty, true, world->chunksX * world->chunksY * sizeof(bool));
+    memset(world->chunkChanged, true, world->chunksX * world->chunksY * sizeof(bool));
+    memset(world->chunkGas, true, world->chunksX * world->chunksY * sizeof(bool));
+    memset(world->chunkUnsaved, true, world->chunksX * world->chunksY * sizeof(bool));
+}
+
+// Recounts the chunks written since the last count, applying the difference to
+// the world totals. A write may have unsettled cells in the chunk, so those chunks
+// are due a visit as well. Returns how many of them had not been recounted already
+// this tick, so a tick's calls add up to the chunks it wrote.
+int refreshPopulations(World* world) {
+    int recounted = 0;
+    for (int cy = 0; cy < world->chunksY; cy++) {
+        for (int cx = 0; cx < world->chunksX; cx++) {
+            int chunk = cy * world->chunksX + cx;
+            if (!world->chunkChanged[chunk]) {
+                continue;
+            }
+            world->chunkChanged[chunk] = false;
+            world->chunkDue[chunk] = 0;
+
+            int counts[MATERIAL_COUNT] = {0};
+            for (int y = cy * CHUNK_SIZE; y < (cy + 1) * CHUNK_SIZE && y < world->height; y++) {
+                const int* row = world->grid[y];
+                for (int x = cx * CHUNK_SIZE; x < (cx + 1) * CHUNK_SIZE && x < world->width; x++) {
+                    counts[row[x]]++;
+                }
+            }
+
+            int* previous = world->chunkPopulation + (size_t)chunk * MATERIAL_COUNT;
+            unsigned int materials = 0;
+            for (int m = 0; m < MATERIAL_COUNT; m++) {
+                world->population[m] += counts[m] - previous[m];
+                previous[m] = counts[m];
+                materials |= (unsigned int)(counts[m] > 0) << m;
+            }
+            world->chunkMaterials[chunk] = materials;
+            recounted += !world->chunkRecounted[chunk];
+            world->chunkRecounted[chunk] = true;
+        }
+    }
+    return recounted;
+}
+
+// Empties every cell in place; the layout is unchanged
+void clearWorld(World* world) {
+    size_t bytes = (size_t)world->width * world->height * sizeof(int);
+    memset(world->grid[0], 0, bytes);
+    for (int i = 0; i < TIMER_PLANE_COUNT; i++) {
+        memset(world->timerPlanes[i][0], 0, bytes);
+    }
+    markAllChunksChanged(world);
+}
+
+void destroyWorld(World* world) {
+    arenaUnmap(&world->arena);
+}
+
+// Grid followed by the timer planes, in checkpoint order
+void worldPlanes(World* world, int*** planes) {
+    planes[0] = world->grid;
+    for (int i = 0; i < TIMER_PLANE_COUNT; i++) {
+        planes[i + 1] = world->timerPlanes[i];
+    }
+}
+
+// Procedural worlds: value-noise terrain of dirt over stone with sand strata,
+// water filling the basins below a water table, gas pockets trapped in the rock
+// and grass seeds on dry dirt. Every cell is a pure function of the seed and its
+// position, so chunks are filled by worker threads in any order.
+#define GENERATOR_MAX_THREADS 16
+
+typedef struct {
+    World* world;
+    unsigned int seed;
+    int first;                  // Chunks first, first + stride, ... belong to this worker
+    int stride;
+} GeneratorJob;
+
+// Smooth value noise in [0, 1] with lattice spacing `scale`; `layer` picks an independent field
+float valueNoise(unsigned int seed, int layer, float x, float y, float scale) {
+    float fx = x / scale;
+    float fy = y / scale;
+    int ix = (int)floorf(fx);
+    int iy = (int)floorf(fy);
+    float tx = fx - ix;
+    float ty = fy - iy;
+    tx = tx * tx * (3.0f - 2.0f * tx);
+    ty = ty * ty * (3.0f - 2.0f * ty);
+
+    float corners[4];
+    for (int i = 0; i < 4; i++) {
+        corners[i] = (hashCoords(seed, layer, ix + (i & 1), iy + (i >> 1)) >> 8) / (float)(1 << 24);
+    }
+    float top = corners[0] + (corners[1] - corners[0]) * tx;
+    float bottom = corners[2] + (corners[3] - corners[2]) * tx;
+    return top + (bottom - top) * ty;
+}
+
+// Three octaves of value noise, still in [0, 1]
+float fractalNoise(unsigned int seed, int layer, float x, float y, float scale) {
+    return (valueNoise(seed, layer, x, y, scale) * 4.0f +
+            valueNoise(seed, layer + 1, x, y, scale / 2) * 2.0f +
+            valueNoise(seed, layer + 2, x, y, scale / 4)) / 7.0f;
+}
+
+// Material of world cell (x, y) in a world `height` cells tall
+int generatedMaterial(unsigned int seed, int height, int x, int y) {
+    int surface = (int)(height * (0.3f + 0.4f * fractalNoise(seed, 0, x, 0, 96.0f)));
+    int waterTable = (int)(height * 0.5f);
+    int dirtDepth = 3 + (int)(6.0f * valueNoise(seed, 3, x, 0, 24.0f));
+
+    if (y < surface) {
+        if (y >= waterTable) {
+            return WATER;
+        }
+        // A seed sits on some of the dry surface cells
+        if (y == surface - 1 && (hashCoords(seed, 4, x, y) & 3) == 0) {
+            return GRASS_SEED;
+        }
+        return EMPTY;
+    }
+    if (y < surface + dirtDepth) {
+        return DIRT;
+    }
+    if (fractalNoise(seed, 5, x, y, 48.0f) > 0.68f) {
+        return GAS;
+    }
+    // Sand strata: bands that wander slowly with x
+    float band = (y + 24.0f * valueNoise(seed, 8, x, 0, 64.0f)) / 18.0f;
+    if (band - floorf(band) < 0.3f) {
+        return SAND;
+    }
+    return STONE;
+}
+
+void* generatorThread(void* arg) {
+    GeneratorJob* job = (GeneratorJob*)arg;
+    World* world = job->world;
+
+    for (int chunk = job->first; chunk < world->chunksX * world->chunksY; chunk += job->stride) {
+        int x0 = (chunk % world->chunksX) * CHUNK_SIZE;
+        int y0 = (chunk / world->chunksX) * CHUNK_SIZE;
+        for (int y = y0; y < y0 + CHUNK_SIZE && y < world->height; y++) {
+            for (int x = x0; x < x0 + CHUNK_SIZE && x < world->width; x++) {
+                world->grid[y][x] = generatedMaterial(job->seed, world->worldHeight, x, world->originY + y);
+                if (world->grid[y][x] == GAS) {
+                    world->timerPlanes[PLANE_GAS_DENSITY][y][x] = GAS_UNIT;
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+// Replaces the world's contents with a generated landscape
+void generateWorld(World* world, unsigned int seed) {
+    clearWorld(world);
+
+    long threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threadCount < 1) threadCount = 1;
+    if (threadCount > GENERATOR_MAX_THREADS) threadCount = GENERATOR_MAX_THREADS;
+
+    pthread_t threads[GENERATOR_MAX_THREADS];
+    GeneratorJob jobs[GENERATOR_MAX_THREADS];
+    for (int i = 0; i < threadCount; i++) {
+        jobs[i] = (GeneratorJob){ world, seed, i, (int)threadCount };
+        pthread_create(&threads[i], NULL, generatorThread, &jobs[i]);
+    }
+    for (int i = 0; i < threadCount; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+#define MAX_EVAPORATIONS_PER_TICK 10
+
+// Updates local rows [firstRow, lastRow), bottom to top
+void stepRows(World* world, int firstRow, int lastRow) {
+    int gridWidth = world->width;
+    int gridHeight = world->height;
+    int** grid = world->grid;
+    int*** timerPlanes = world->timerPlanes;
+    bool** updated = world->updated;
+    // Cells with no rule of their own and no reactions are left alone
+    bool idle[MATERIAL_COUNT];
+    unsigned int activeMaterials = 0;
+    for (int material = 0; material < MATERIAL_COUNT; material++) {
+        idle[material] = !hasUpdateRule[material] && !hasReactions[material];
+        activeMaterials |= (unsigned int)!idle[material] << material;
+    }
+    // Settled materials only need a turn in chunks that are due: written since their
+    // last visit, or holding a plant that is due. Those chunks have their marker
+    // raised here, and the plants visited this tick lower it again.
+    for (int material = 0; material < MATERIAL_COUNT; material++) {
+        activeMaterials &= ~((unsigned int)settles[material] << material);
+    }
+    int firstChunk = (firstRow / CHUNK_SIZE) * world->chunksX;
+    int lastChunk = ((lastRow - 1) / CHUNK_SIZE + 1) * world->chunksX;
+    for (int chunk = firstChunk; chunk < lastChunk; chunk++) {
+        world->chunkAwake[chunk] = world->chunkDue[chunk] <= world->tick;
+        if (world->chunkAwake[chunk]) {
+            world->chunkDue[chunk] = LONG_MAX;
+        }
+    }
+    long* growthDue = world->chunkDue;
+
+    for (int y = lastRow - 1; y >= firstRow; y--) {
+        int worldY = world->originY + y;
+        bool edgeRow = worldY == 0 || worldY == world->worldHeight - 1;
+        int chunkRow = (y / CHUNK_SIZE) * world->chunksX;
+        int growthFloor = rowGrowthFloor(world->tick, worldY, world->worldHeight);
+
+        // Columns run left to right or right to left, alternating by world row and by
+        // tick, so sideways flow has no preferred side and every band agrees on the order
+        int step = ((worldY + world->tick) & 1) ? -1 : 1;
+        int x = (step > 0) ? 0 : gridWidth - 1;
+        int entry = (step > 0) ? 0 : CHUNK_SIZE - 1;
+        for (int i = 0; i < gridWidth; i++, x += step) {
+            // A chunk holding only idle and settled materials is passed over whole,
+            // unless it is due or has been written since it was counted
+            if (i == 0 || (x & (CHUNK_SIZE - 1)) == entry) {
+                int chunk = chunkRow + x / CHUNK_SIZE;
+                growthDue = world->chunkDue + chunk;
+                if (!world->chunkChanged[chunk] && !(world->chunkMaterials[chunk] & activeMaterials) &&
+                    !world->chunkAwake[chunk]) {
+                    int exit = (step > 0) ? (x | (CHUNK_SIZE - 1)) : (x & ~(CHUNK_SIZE - 1));
+                    if (exit >= gridWidth) exit = gridWidth - 1;
+                    i += (exit - x) * step;
+                    x = exit;
+                    continue;
+                }
+                // Cells that stay put still tick their timers
+                world->chunkUnsaved[chunk] = true;
+            }
+            if (updated[y][x] || idle[grid[y][x]]) {
+                continue;
+            }
+
+            int ahead = x + step;
+            bool hasAhead = ahead >= 0 && ahead < gridWidth;
+            int aheadBefore = hasAhead ? grid[y][ahead] : EMPTY;
+
+            seedCellRandom(world->seed, world->tick, x, worldY);
+            neighbourRewritten = false;
+            bool edge = edgeRow || x == 0 || x == gridWidth - 1;
+            updated[y][x] = edge ? stepEdgeCell(gridHeight, gridWidth, grid, timerPlanes, world->originY,
+                                                world->worldHeight, &world->growthBudget, growthFloor,
+                                                world->tick, growthDue, x, y)
+                                 : stepInteriorCell(gridHeight, gridWidth, grid, timerPlanes, world->originY,
+                                                    world->worldHeight, &world->growthBudget, growthFloor,
+                                                    world->tick, growthDue, x, y);
+
+            // Whatever this cell moved or turned into the next column has had its turn
+            if (updated[y][x] && hasAhead && grid[y][ahead] != aheadBefore) {
+                updated[y][ahead] = true;
+            }
+
+            // Moves and reactions reach one cell around (x, y), grass sprouts up to 6 above,
+            // and a settled cell rests on the three cells below it, so the chunks holding
+            // the cells resting on those are due a visit too. A reaction can rewrite a
+            // neighbour and leave the cell as it was. Animated materials change colour
+            // every tick even when they stay put, which needs a redraw but no recount.
+            if (updated[y][x]) {
+                markChunksChanged(world, x - 2, y - 7, x + 2, y + 1);
+            }
+            else if (neighbourRewritten) {
+                markChunksChanged(world, x - 2, y - 2, x + 2, y + 1);
+            }
+            else if (animatedMaterial[grid[y][x]]) {
+                markChunksDirty(world->chunkDirty, world->chunksX, world->chunksY, x - 1, y - 1, x + 1, y + 1);
+            }
+        }
+    }
+}
+
+// Advances the evaporation clock; true on ticks where old acid evaporates
+bool evaporationDue(World* world) {
+    world->evaporationCounter++;
+    if (world->evaporationCounter >= EVAPORATION_TIME) {
+        world->evaporationCounter = 0;
+        return true;
+    }
+    return false;
+}
+
+// Removes up to `limit` expired acid cells from local rows [firstRow, lastRow), top to bottom
+int evaporateRows(World* world, int firstRow, int lastRow, int limit) {
+    int** grid = world->grid;
+    int** acidStage = world->timerPlanes[PLANE_ACID_STAGE];
+    int** acidTimer = world->timerPlanes[PLANE_ACID_TIMER];
+
+    int evaporated = 0;
+    for (int y = firstRow; y < lastRow && evaporated < limit; y++) {
+        // Chunks known to hold no acid are skipped
+        int chunkRow = (y / CHUNK_SIZE) * world->chunksX;
+        for (int x = 0; x < world->width && evaporated < limit; x++) {
+            int chunk = chunkRow + x / CHUNK_SIZE;
+            if (!world->chunkChanged[chunk] && !(world->chunkMaterials[chunk] & (1u << ACID))) {
+                x |= CHUNK_SIZE - 1;
+                continue;
+            }
+            if (grid[y][x] == ACID && acidTimer[y][x] >= EVAPORATION_TIME) {
+                grid[y][x] = EMPTY;
+                acidStage[y][x] = 0;
+                acidTimer[y][x] = 0;
+                markChunksChanged(world, x - 1, y - 1, x + 1, y);
+                evaporated++;
+            }
+        }
+    }
+    return evaporated;
+}
+
+// Gas field: GAS and ACID_GAS move as concentrations rather than as cells. Each
+// tick a conservative stencil trades gas across every face between open cells
+// (EMPTY or either gas): an eighth of the difference diffuses and, while the
+// cell above has room, a quarter of the lower cell's gas rises. A closed cell
+// holding gas, such as sand that fell into a cloud, pushes it all into an open
+// cell above. Gas then decays, and the grid marker is derived from the result:
+// GAS where it is dense enough to see, otherwise ACID_GAS, otherwise EMPTY, so
+// ignition and dissipation are thresholds on the concentration. Decay rounds up,
+// so every cell holding gas loses some each tick and a field with no source
+// drains to nothing.
+#define GAS_VISIBLE (GAS_UNIT / 16)
+#define GAS_MIN (GAS_UNIT / 1024)
+#define GAS_DECAY_SHIFT 10
+#define ACID_GAS_DECAY_SHIFT 6
+
+KERNEL int gasOpen(int material) {
+    return material == EMPTY || material == GAS || material == ACID_GAS;
+}
+
+// Gas crossing a vertical face upward, from `below` into `above`. The open flags
+// are 0 or 1 and select through masks rather than branches, so callers vectorize.
+KERNEL int gasRise(int below, int above, int belowOpen, int aboveOpen) {
+    int room = GAS_UNIT - above;
+    int maxLift = (room > 0 ? room : 0) / 2;
+    int lift = below / 4 < maxLift ? below / 4 : maxLift;
+    int flow = (((below - above) / 8 + lift) & -belowOpen) | (below & (belowOpen - 1));
+    return flow & -aboveOpen;
+}
+
+// One row of the stencil. Every row argument is padded by one cell on each side,
+// with closed, empty padding, so the loop has no edge cases and vectorizes.
+KERNEL void gasStencilRow(int* restrict out, const int* restrict above, const int* restrict row,
+                          const int* restrict below, const int* restrict openAbove,
+                          const int* restrict open, const int* restrict openBelow,
+                          int width, int decayShift) {
+    for (int x = 1; x <= width; x++) {
+        int c = row[x];
+        int o = open[x];
+        int d = c;
+        d += ((row[x - 1] - c) / 8) & -(open[x - 1] & o);
+        d += ((row[x + 1] - c) / 8) & -(open[x + 1] & o);
+        d += gasRise(below[x], c, openBelow[x], o);
+        d -= gasRise(c, above[x], o, openAbove[x]);
+        d -= (d + (1 << decayShift) - 1) >> decayShift;
+        out[x - 1] = d & -(d >= GAS_MIN);
+    }
+}
+
+// True if any of `width` padded cells, or the padding beside them, holds gas in the
+// rows above, at or below; where none does, the stencil would leave the row at zero
+KERNEL bool gasRowsLive(const int* above, const int* row, const int* below, int width) {
+    int live = 0;
+    for (int x = 0; x <= width + 1; x++) {
+        live |= above[x] | row[x] | below[x];
+    }
+    return live != 0;
+}
+
+// Fills a padded row of 0/1 open flags for grid row `y`, all closed past the grid
+void gasOpenRow(int* open, World* world, int y) {
+    memset(open, 0, (world->width + 2) * sizeof(int));
+    if (y < 0 || y >= world->height) {
+        return;
+    }
+    const int* grid = world->grid[y];
+    for (int x = 0; x < world->width; x++) {
+        open[x + 1] = gasOpen(grid[x]);
+    }
+}
+
+// Copies density row `y` into a padded row, empty past the grid
+void gasCopyRow(int* padded, int** plane, World* world, int y) {
+    padded[0] = 0;
+    padded[world->width + 1] = 0;
+    if (y < 0 || y >= world->height) {
+        memset(padded + 1, 0, world->width * sizeof(int));
+    } else {
+        memcpy(padded + 1, plane[y], world->width * sizeof(int));
+    }
+}
+
+// Fills `flags` with 1 for each chunk of chunk row `cy` that may hold gas, 0 past the world
+void gasChunkRow(int* flags, World* world, int cy) {
+    unsigned int gasMaterials = (1u << GAS) | (1u << ACID_GAS);
+    for (int cx = 0; cx < world->chunksX; cx++) {
+        int chunk = cy * world->chunksX + cx;
+        flags[cx] = cy >= 0 && cy < world->chunksY &&
+                    (world->chunkGas[chunk] || world->chunkChanged[chunk] ||
+                     (world->chunkMaterials[chunk] & gasMaterials));
+    }
+}
+
+// Runs the gas field over local rows [firstRow, lastRow), reading one row past each end.
+// Within those rows only chunks with gas in or next to them are visited: gas moves at
+// most a cell a tick, so every other chunk is left as it was.
+void gasFieldRows(World* world, int firstRow, int lastRow) {
+    int width = world->width;
+    int chunksX = world->chunksX;
+    int** gas = world->timerPlanes[PLANE_GAS_DENSITY];
+    int** acidGas = world->timerPlanes[PLANE_ACID_GAS_DENSITY];
+
+    // Chunk flags for the chunk rows above, at and below the current one, taken before
+    // the current row rewrites them, and the columns of chunks the current row visits
+    int* chunkRows[3] = { world->gasScratch[9], world->gasScratch[10], world->gasScratch[11] };
+    int* columns = world->gasScratch[12];
+
+    // Rows are rewritten in place top to bottom, so the stencil reads old values
+    // from three rotating padded copies per plane: above, this row and below
+    int* gasRows[3] = { world->gasScratch[0], world->gasScratch[1], world->gasScratch[2] };
+    int* acidRows[3] = { world->gasScratch[3], world->gasScratch[4], world->gasScratch[5] };
+    int* openRows[3] = { world->gasScratch[6], world->gasScratch[7], world->gasScratch[8] };
+    for (int i = 0; i < 2; i++) {
+        gasCopyRow(gasRows[i], gas, world, firstRow - 1 + i);
+        gasCopyRow(acidRows[i], acidGas, world, firstRow - 1 + i);
+        gasOpenRow(openRows[i], world, firstRow - 1 + i);
+    }
+
+    for (int y = firstRow; y < lastRow; y++) {
+        int cy = y / CHUNK_SIZE;
+        if (y == firstRow || y % CHUNK_SIZE == 0) {
+            if (y == firstRow) {
+                gasChunkRow(chunkRows[1], world, cy - 1);
+                gasChunkRow(chunkRows[2], world, cy);
+            }
+            int* rotate = chunkRows[0];
+            chunkRows[0] = chunkRows[1];
+            chunkRows[1] = chunkRows[2];
+            chunkRows[2] = rotate;
+            gasChunkRow(chunkRows[2], world, cy + 1);
+            for (int cx = 0; cx < chunksX; cx++) {
+                int near = 0;
+                for (int dx = -1; dx <= 1; dx++) {
+                    if (cx + dx >= 0 && cx + dx < chunksX) {
+                        near |= chunkRows[0][cx + dx] | chunkRows[1][cx + dx] | chunkRows[2][cx + dx];
+                    }
+                }
+                columns[cx] = near;
+            }
+        }
+
+        gasCopyRow(gasRows[2], gas, world, y + 1);
+        gasCopyRow(acidRows[2], acidGas, world, y + 1);
+        gasOpenRow(openRows[2], world, y + 1);
+
+        // The stencil runs over each run of visited chunks; its padded rows hold the real
+        // neighbours at the ends of a run
+        for (int cx0 = 0; cx0 < chunksX; cx0++) {
+            if (!columns[cx0]) continue;
+            int cx1 = cx0;
+            while (cx1 < chunksX && columns[cx1]) cx1++;
+            int x0 = cx0 * CHUNK_SIZE;
+            int runWidth = (cx1 * CHUNK_SIZE < width ? cx1 * CHUNK_SIZE : width) - x0;
+            if (gasRowsLive(gasRows[0] + x0, gasRows[1] + x0, gasRows[2] + x0, runWidth)) {
+                gasStencilRow(gas[y] + x0, gasRows[0] + x0, gasRows[1] + x0, gasRows[2] + x0,
+                              openRows[0] + x0, openRows[1] + x0, openRows[2] + x0, runWidth, GAS_DECAY_SHIFT);
+            }
+            if (gasRowsLive(acidRows[0] + x0, acidRows[1] + x0, acidRows[2] + x0, runWidth)) {
+                gasStencilRow(acidGas[y] + x0, acidRows[0] + x0, acidRows[1] + x0, acidRows[2] + x0,
+                              openRows[0] + x0, openRows[1] + x0, openRows[2] + x0, runWidth,
+                              ACID_GAS_DECAY_SHIFT);
+            }
+            cx0 = cx1;
+        }
+
+        // Derive the markers chunk by chunk, so the dirty flag is written once per chunk
+        int* restrict grid = world->grid[y];
+        const int* restrict gasRow = gas[y];
+        const int* restrict acidRow = acidGas[y];
+        const int* restrict open = openRows[1] + 1;
+        for (int x0 = 0; x0 < width; x0 += CHUNK_SIZE) {
+            if (!columns[x0 / CHUNK_SIZE]) continue;
+            int x1 = x0 + CHUNK_SIZE < width ? x0 + CHUNK_SIZE : width;
+            int chunk = cy * chunksX + x0 / CHUNK_SIZE;
+            int rewritten = 0;
+            int visible = 0;
+            int live = 0;
+            // A chunk visited only for its neighbours holds no gas cells, so its markers
+            // can only change where gas has just arrived
+            if (!chunkRows[1][x0 / CHUNK_SIZE]) {
+                for (int x = x0; x < x1; x++) {
+                    live |= gasRow[x] | acidRow[x];
+                }
+                if (!live) continue;
+            }
+            int firstBefore = grid[x0];
+            int lastBefore = grid[x1 - 1];
+            for (int x = x0; x < x1; x++) {
+                int gasVisible = gasRow[x] >= GAS_VISIBLE;
+                int acidVisible = acidRow[x] >= GAS_VISIBLE;
+                int marker = gasVisible * GAS + (acidVisible & !gasVisible) * ACID_GAS;
+                int material = grid[x] ^ ((grid[x] ^ marker) & -open[x]);
+                rewritten |= material != grid[x];
+                visible |= gasVisible | acidVisible;
+                live |= gasRow[x] | acidRow[x];
+                grid[x] = material;
+            }
+            // Visible gas shades with its density every tick; only new markers need a recount
+            if (rewritten | visible) {
+                world->chunkDirty[chunk] = true;
+            }
+            // Settled cells in the row above may rest on a rewritten marker, which can
+            // reach into the chunks beside and above
+            if (rewritten) {
+                markChunksDirty(world->chunkChanged, chunksX, world->chunksY,
+                                grid[x0] != firstBefore ? x0 - 1 : x0, y - 1,
+                                grid[x1 - 1] != lastBefore ? x1 : x1 - 1, y);
+            }
+            // Density moves and decays below the visible level too, and can decay to nothing
+            if (rewritten | live | world->chunkGas[chunk]) {
+                world->chunkUnsaved[chunk] = true;
+            }
+            // A chunk's gas flag is rebuilt over its rows, starting at its top row
+            world->chunkGas[chunk] = (world->chunkGas[chunk] && y % CHUNK_SIZE != 0) || live;
+        }
+
+        int* rotate = gasRows[0];
+        gasRows[0] = gasRows[1];
+        gasRows[1] = gasRows[2];
+        gasRows[2] = rotate;
+        rotate = acidRows[0];
+        acidRows[0] = acidRows[1];
+        acidRows[1] = acidRows[2];
+        acidRows[2] = rotate;
+        rotate = openRows[0];
+        openRows[0] = openRows[1];
+        openRows[1] = openRows[2];
+        openRows[2] = rotate;
+    }
+}
+
+bool chunkRowHasGas(World* world, int cy) {
+    unsigned int gasMaterials = (1u << GAS) | (1u << ACID_GAS);
+    for (int cx = 0; cx < world->chunksX; cx++) {
+        int chunk = cy * world->chunksX + cx;
+        if (world->chunkGas[chunk] || (world->chunkMaterials[chunk] & gasMaterials)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Finds the next span of rows the gas pass must visit, searching from chunk row
+// `*next`: a run of chunk rows holding gas cells or density, widened by a chunk row
+// each way. Rows further out hold no gas and gain none this tick, so skipping them
+// leaves the result unchanged. Pockets at different depths get spans of their own.
+// False when no gas is left below `*next`.
+bool nextGasRows(World* world, int* next, int* firstRow, int* lastRow) {
+    int firstChunkRow = -1;
+    int lastChunkRow = -1;
+    for (int cy = *next; cy < world->chunksY; cy++) {
+        if (chunkRowHasGas(world, cy)) {
+            if (firstChunkRow < 0) firstChunkRow = cy;
+            lastChunkRow = cy;
+        } else if (firstChunkRow >= 0 && cy > lastChunkRow + 1) {
+            // Gas further down would widen into a separate span
+            break;
+        }
+    }
+    if (firstChunkRow < 0) {
+        return false;
+    }
+
+    *next = lastChunkRow + 2;
+    *firstRow = (firstChunkRow > 0 ? firstChunkRow - 1 : 0) * CHUNK_SIZE;
+    *lastRow = (lastChunkRow + 2) * CHUNK_SIZE;
+    if (*lastRow > world->height) *lastRow = world->height;
+    return true;
+}
+
+// Publishes the world's counters to the metrics page
+void publishTelemetry(World* world) {
+    atomic_store_explicit(&telemetry.ticks, world->tick, memory_order_relaxed);
+    atomic_store_explicit(&telemetry.chunkCount, world->chunksX * world->chunksY, memory_order_relaxed);
+    atomic_store_explicit(&telemetry.arenaBytes, (long)world->arena.capacity, memory_order_relaxed);
+    atomic_store_explicit(&telemetry.arenaUsed, (long)world->arena.used, memory_order_relaxed);
+
+    for (int i = 0; i < MATERIAL_COUNT; i++) {
+        atomic_store_explicit(&telemetry.population[i], world->population[i], memory_order_relaxed);
+    }
+}
+
+void stepWorld(World* world) {
+    memset(world->updated[0], 0, (size_t)world->width * world->height * sizeof(bool));
+    memset(world->chunkRecounted, false, world->chunksX * world->chunksY * sizeof(bool));
+    world->growthBudget = GROWTH_BUDGET;
+    long start = nowNanos();
+    stepRows(world, 0, world->height);
+    if (world->publishes) {
+        addPhaseTime(PHASE_STEP, start);
+    }
+    if (evaporationDue(world)) {
+        start = nowNanos();
+        int evaporated = evaporateRows(world, 0, world->height, MAX_EVAPORATIONS_PER_TICK);
+        if (world->publishes) {
+            atomic_fetch_add_explicit(&telemetry.evaporated, evaporated, memory_order_relaxed);
+            addPhaseTime(PHASE_EVAPORATION, start);
+        }
+    }
+    // Counts are brought up to date before the gas pass so it can find the gas, and
+    // again after it for the markers it rewrote
+    int active = refreshPopulations(world);
+    start = nowNanos();
+    int nextChunkRow = 0;
+    int firstGasRow;
+    int lastGasRow;
+    while (nextGasRows(world, &nextChunkRow, &firstGasRow, &lastGasRow)) {
+        gasFieldRows(world, firstGasRow, lastGasRow);
+    }
+    if (world->publishes) {
+        addPhaseTime(PHASE_GAS, start);
+    }
+    active += refreshPopulations(world);
+    world->tick++;
+
+    if (world->publishes) {
+        atomic_store_explicit(&telemetry.activeChunks, active, memory_order_relaxed);
+        atomic_fetch_add_explicit(&telemetry.growthEvents, GROWTH_BUDGET - world->growthBudget, memory_order_relaxed);
+        publishTelemetry(world);
+    }
+}
+
+
+// Multi-process mode: the world is cut into horizontal bands of whole chunk rows,
+// each stepped by its own process. A band loads or generates only its own rows and
+// HALO_ROWS rows of each neighbour, deep enough for the furthest reach of any rule
+// (grass growing six cells up), and talks only to the bands above and below it:
+// over socket pairs when `--domains` forks the bands on one machine, or over TCP
+// when each band is started with `--node` on a machine of its own.
+//
+// Because the scan runs bottom to top, a band steps tick t only after the band
+// below has, and hands the rows it wrote across the boundary back to their owner.
+// The growth budget is spent in that same order, so what is left of it is passed
+// up the bands; evaporation is capped per tick in top-to-bottom order, so the
+// count used so far is passed down. With per-cell random streams the result
+// matches stepWorld.
+//
+// Nothing gathers the world. At a checkpoint each band encodes its own chunks and
+// sends the records up the chain, and band 0 writes them to the file as they
+// arrive. A band that cannot talk to a neighbour exits non-zero; closing its links
+// makes the neighbours fail in turn, so the whole run stops.
+#define HALO_ROWS 8
+#define NODE_CONNECT_SECONDS 60
+#define RECORD_END 0xFFFFFFFFu
+
+typedef struct {
+    int index;                  // Band number from the top, and the number of bands
+    int count;
+    int firstRow;               // Own world rows [firstRow, lastRow)
+    int lastRow;
+    int haloTop;                // Halo rows above and below in the band's local grid
+    int haloBottom;
+    int upFd;                   // Link to the band above, or -1
+    int downFd;                 // Link to the band below, or -1
+} Domain;
+
+// What every band of a run is told: where its world comes from, how far to step it
+// and where the checkpoints go
+typedef struct {
+    int width;
+    int height;
+    unsigned int seed;
+    const char* restoreDir;     // Shared checkpoint to load the band from, or NULL
+    int restoreBase;
+    bool generate;              // Otherwise the band starts empty
+    unsigned int generateSeed;
+    long ticks;
+    const char* checkpointDir;  // Written by band 0, or NULL
+    int checkpointInterval;
+    int metricsPort;            // Served by band 0, or 0
+} BandRun;
+
+// Band `index` of `count` takes whole chunk rows, the last one also the short chunk
+// row at the bottom, so each band owns its chunks outright
+void planDomain(Domain* domain, int index, int count, int worldHeight) {
+    int chunksY = worldHeight / CHUNK_SIZE;
+    domain->index = index;
+    domain->count = count;
+    domain->firstRow = (int)((long)chunksY * index / count) * CHUNK_SIZE;
+    domain->lastRow = (index == count - 1) ? worldHeight : (int)((long)chunksY * (index + 1) / count) * CHUNK_SIZE;
+    domain->haloTop = (index > 0) ? HALO_ROWS : 0;
+    domain->haloBottom = (index < count - 1) ? HALO_ROWS : 0;
+    domain->upFd = -1;
+    domain->downFd = -1;
+}
+
+// Most bands a world can be cut into: one per full chunk row
+int maxDomains(int worldHeight) {
+    return (worldHeight / CHUNK_SIZE > 1) ? worldHeight / CHUNK_SIZE : 1;
+}
+
+bool sendAll(int fd, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    while (size > 0) {
+        ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool recvAll(int fd, void* data, size_t size) {
+    unsigned char* bytes = (unsigned char*)data;
+    while (size > 0) {
+        ssize_t received = read(fd, bytes, size);
+        if (received <= 0) return false;
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+// Sends or receives `count` rows of every plane starting at local row `row`; false
+// if the link closed or failed part way
+bool sendRows(int fd, World* world, int row, int count) {
+    int** planes[CHECKPOINT_PLANES];
+    worldPlanes(world, planes);
+    for (int p = 0; p < CHECKPOINT_PLANES; p++) {
+        if (!sendAll(fd, planes[p][row], (size_t)count * world->width * sizeof(int))) return false;
+    }
+    return true;
+}
+
+bool recvRows(int fd, World* world, int row, int count) {
+    int** planes[CHECKPOINT_PLANES];
+    worldPlanes(world, planes);
+    for (int p = 0; p < CHECKPOINT_PLANES; p++) {
+        if (!recvAll(fd, planes[p][row], (size_t)count * world->width * sizeof(int))) return false;
+    }
+    // The rows were written from outside, so their chunks and those of the cells
+    // resting on them are visited again, as after any other write
+    markChunksChanged(world, 0, row - 7, world->width - 1, row + count - 1);
+    return true;
+}
+
+// One tick of a band, own rows [top, bottom); false if a link to a neighbour failed
+bool stepDomain(World* band, Domain* domain, int top, int bottom) {
+    memset(band->updated[0], 0, (size_t)band->width * band->height * sizeof(bool));
+
+    // The band below has stepped: take its top rows, our bottom rows as it left them
+    // and what it left of the growth budget
+    band->growthBudget = GROWTH_BUDGET;
+    if (domain->downFd >= 0 &&
+        (!recvRows(domain->downFd, band, bottom, HALO_ROWS) ||
+         !recvRows(domain->downFd, band, bottom - HALO_ROWS, HALO_ROWS) ||
+         !recvAll(domain->downFd, &band->growthBudget, sizeof(band->growthBudget)))) {
+        return false;
+    }
+
+    stepRows(band, top, bottom);
+
+    if (domain->upFd >= 0 &&
+        (!sendRows(domain->upFd, band, top, HALO_ROWS) ||
+         !sendRows(domain->upFd, band, top - HALO_ROWS, HALO_ROWS) ||
+         !sendAll(domain->upFd, &band->growthBudget, sizeof(band->growthBudget)))) {
+        return false;
+    }
+    if (domain->downFd >= 0 && !sendRows(domain->downFd, band, bottom, HALO_ROWS)) return false;
+    if (domain->upFd >= 0 && !recvRows(domain->upFd, band, top, HALO_ROWS)) return false;
+
+    if (evaporationDue(band)) {
+        int used = 0;
+        if (domain->upFd >= 0 && !recvAll(domain->upFd, &used, sizeof(used))) return false;
+        used += evaporateRows(band, top, bottom, MAX_EVAPORATIONS_PER_TICK - used);
+        if (domain->downFd >= 0 && !sendAll(domain->downFd, &used, sizeof(used))) return false;
+    }
+
+    // The gas field reads one row past each end of the band as it ended the step
+    if (domain->upFd >= 0 && !sendRows(domain->upFd, band, top, 1)) return false;
+    if (domain->downFd >= 0 &&
+        (!recvRows(domain->downFd, band, bottom, 1) || !sendRows(domain->downFd, band, bottom - 1, 1))) {
+        return false;
+    }
+    if (domain->upFd >= 0 && !recvRows(domain->upFd, band, top - 1, 1)) return false;
+
+    gasFieldRows(band, top, bottom);
+
+    // Final state of the boundary rows for the next tick's reads
+    if (domain->downFd >= 0 && !sendRows(domain->downFd, band, bottom - HALO_ROWS, HALO_ROWS)) return false;
+    if (domain->upFd >= 0 && !recvRows(domain->upFd, band, top - HALO_ROWS, HALO_ROWS)) return false;
+
+    // Chunks left unwritten this tick can be passed over in the next one
+    refreshPopulations(band);
+    band->tick++;
+    return true;
+}
+
+// Passes the chunk records arriving on `fd` on, to the file (band 0) or to the band
+// above, until the end marker. False if a link failed or a record is malformed.
+bool relayRecords(int fd, FILE* file, int upFd, unsigned char* buffer, unsigned int* written) {
+    while (true) {
+        unsigned char header[RECORD_HEADER_BYTES];
+        if (!recvAll(fd, header, sizeof(header))) return false;
+        if (loadU32(header) == RECORD_END) return true;
+
+        size_t size = loadU32(header + 12);
+        if (size > CHUNK_RAW_BYTES * 2 || !recvAll(fd, buffer, size)) return false;
+        if (file != NULL) {
+            fwrite(header, 1, sizeof(header), file);
+            fwrite(buffer, 1, size, file);
+        }
+        if (upFd >= 0 && (!sendAll(upFd, header, sizeof(header)) || !sendAll(upFd, buffer, size))) return false;
+        (*written)++;
+    }
+}
+
+// One checkpoint of a multi-process run. Band 0 decides whether it is a base and
+// passes that down; each band then sends its changed chunks up, followed by those
+// of the bands below it, and band 0 writes them all into one file. False if a link
+// failed.
+bool checkpointDomain(World* band, Domain* domain, CheckpointWriter* writer) {
+    int width = band->width;
+    int height = band->worldHeight;
+    bool base;
+    if (domain->upFd < 0) {
+        base = checkpointBase(writer, height, width);
+    } else {
+        if (!recvAll(domain->upFd, &base, sizeof(base))) return false;
+        if (base) {
+            free(writer->hashes);
+            writer->hashes = NULL;
+        }
+        checkpointBase(writer, height, width);
+    }
+    if (domain->downFd >= 0 && !sendAll(domain->downFd, &base, sizeof(base))) return false;
+
+    // Band 0 still drains the records when its file cannot be opened
+    FILE* file = (domain->upFd < 0) ? beginCheckpoint(writer, height, width, base, band->tick) : NULL;
+    bool encoding = domain->upFd >= 0 || file != NULL;
+    int** planes[CHECKPOINT_PLANES];
+    worldPlanes(band, planes);
+    int chunksX = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    unsigned int written = 0;
+    bool ok = true;
+    for (int cy = domain->firstRow / CHUNK_SIZE; ok && encoding && cy * CHUNK_SIZE < domain->lastRow; cy++) {
+        for (int cx = 0; ok && cx < chunksX; cx++) {
+            unsigned char header[RECORD_HEADER_BYTES];
+            size_t size = encodeRecord(writer, height, width, planes, band->originY, cx, cy, base, header);
+            if (size == 0) continue;
+            if (file != NULL) {
+                fwrite(header, 1, sizeof(header), file);
+                fwrite(writer->packed, 1, size, file);
+            } else {
+                ok = sendAll(domain->upFd, header, sizeof(header)) && sendAll(domain->upFd, writer->packed, size);
+            }
+            written++;
+        }
+    }
+
+    ok = ok && (domain->downFd < 0 || relayRecords(domain->downFd, file, domain->upFd, writer->packed, &written));
+    if (ok && domain->upFd >= 0) {
+        unsigned char end[RECORD_HEADER_BYTES] = {0};
+        storeU32(end, RECORD_END);
+        ok = sendAll(domain->upFd, end, sizeof(end));
+    }
+    if (file != NULL) {
+        if (ok) {
+            finishCheckpoint(writer, file, written);
+        } else {
+            abandonCheckpoint(writer, file);
+        }
+    }
+    return ok;
+}
+
+// Body of one band process: loads, generates or clears its own rows, then steps them
+// and takes part in the checkpoints. False if the band could not be loaded or a link
+// failed.
+bool runBand(const BandRun* run, Domain* domain) {
+    int ownRows = domain->lastRow - domain->firstRow;
+    int top = domain->haloTop;
+    int bottom = domain->haloTop + ownRows;
+
+    World band;
+    createWorld(&band, run->width, domain->haloTop + ownRows + domain->haloBottom);
+    band.originY = domain->firstRow - domain->haloTop;
+    band.worldHeight = run->height;
+    band.seed = run->seed;
+    if (run->restoreDir != NULL) {
+        int** planes[CHECKPOINT_PLANES];
+        worldPlanes(&band, planes);
+        band.tick = restoreCheckpoints(run->restoreDir, run->restoreBase, run->height, run->width, planes,
+                                       band.originY, band.height);
+        if (band.tick < 0) {
+            destroyWorld(&band);
+            return false;
+        }
+        band.evaporationCounter = (int)(band.tick % EVAPORATION_TIME);
+    } else if (run->generate) {
+        generateWorld(&band, run->generateSeed);
+    }
+
+    // Band 0 serves the metrics page: ticks and time per phase, for the whole run
+    MetricsServer metrics;
+    bool serving = domain->index == 0 && run->metricsPort > 0 && startMetricsServer(&metrics, run->metricsPort);
+    CheckpointWriter writer;
+    bool checkpointing = run->checkpointDir != NULL;
+    if (checkpointing) {
+        initCheckpoints(&writer, domain->index == 0 ? run->checkpointDir : NULL);
+    }
+
+    long start = nowNanos();
+    bool ok = !checkpointing || checkpointDomain(&band, domain, &writer);
+    addPhaseTime(PHASE_CHECKPOINT, start);
+    long endTick = band.tick + run->ticks;
+    while (ok && band.tick < endTick) {
+        start = nowNanos();
+        ok = stepDomain(&band, domain, top, bottom);
+        addPhaseTime(PHASE_STEP, start);
+        atomic_store_explicit(&telemetry.ticks, band.tick, memory_order_relaxed);
+
+        if (ok && checkpointing && (band.tick % run->checkpointInterval == 0 || band.tick == endTick)) {
+            start = nowNanos();
+            ok = checkpointDomain(&band, domain, &writer);
+            addPhaseTime(PHASE_CHECKPOINT, start);
+        }
+    }
+
+    if (serving) {
+        stopMetricsServer(&metrics);
+    }
+    if (checkpointing) {
+        freeCheckpoints(&writer);
+    }
+    destroyWorld(&band);
+    return ok;
+}
+
+// Runs the bands of `run` as `count` forked processes on this machine, linked by
+// socket pairs. The parent holds no world and only waits for them. False if a band
+// could not be started or failed.
+bool runDomains(const BandRun* run, int count) {
+    Domain* domains = (Domain *)malloc(count * sizeof(Domain));
+    pid_t* children = (pid_t *)malloc(count * sizeof(pid_t));
+    for (int i = 0; i < count; i++) {
+        planDomain(&domains[i], i, count, run->height);
+    }
+    bool ok = true;
+    for (int i = 0; ok && i + 1 < count; i++) {
+        int link[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, link) != 0) {
+            TraceLog(LOG_ERROR, "Cannot link domains %d and %d: %s", i, i + 1, strerror(errno));
+            ok = false;
+            break;
+        }
+        domains[i].downFd = link[0];
+        domains[i + 1].upFd = link[1];
+    }
+
+    int started = 0;
+    for (int i = 0; ok && i < count; i++) {
+        children[i] = fork();
+        if (children[i] < 0) {
+            TraceLog(LOG_ERROR, "Cannot start domain %d: %s", i, strerror(errno));
+            ok = false;
+            break;
+        }
+        if (children[i] == 0) {
+            // Keep only this band's links, so that if it dies its neighbours see them close
+            for (int j = 0; j < count; j++) {
+                if (j == i) continue;
+                if (domains[j].downFd >= 0) close(domains[j].downFd);
+                if (domains[j].upFd >= 0) close(domains[j].upFd);
+            }
+            _exit(runBand(run, &domains[i]) ? 0 : 1);
+        }
+        started++;
+    }
+    for (int i = 0; i < count; i++) {
+        if (domains[i].downFd >= 0) close(domains[i].downFd);
+        if (domains[i].upFd >= 0) close(domains[i].upFd);
+    }
+
+    // Bands that were never started leave their neighbours' links closed, so those fail too
+    for (int reaped = 0; reaped < started; reaped++) {
+        int status;
+        pid_t child;
+        do {
+            child = wait(&status);
+        } while (child < 0 && errno == EINTR);
+        if (child < 0) break;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            for (int i = 0; ok && i < started; i++) {
+                if (children[i] == child) TraceLog(LOG_ERROR, "Domain %d failed", i);
+            }
+            ok = false;
+        }
+    }
+
+    free(domains);
+    free(children);
+    return ok;
+}
+
+// Splits "host:port" at its last colon; false if there is no port
+bool splitAddress(const char* address, char* host, size_t hostSize, const char** port) {
+    const char* colon = strrchr(address, ':');
+    if (colon == NULL || colon[1] == '\0' || (size_t)(colon - address) >= hostSize) {
+        TraceLog(LOG_ERROR, "Node address %s is not host:port", address);
+        return false;
+    }
+    memcpy(host, address, colon - address);
+    host[colon - address] = '\0';
+    *port = colon + 1;
+    return true;
+}
+
+// Band links carry many small messages per tick, so they are sent without delay
+void tuneLink(int fd) {
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+// Listens on the port of `address` on every interface, for the band below; -1 on failure
+int listenNode(const char* address) {
+    char host[256];
+    const char* port;
+    if (!splitAddress(address, host, sizeof(host), &port)) return -1;
+
+    struct addrinfo hints = {0};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    struct addrinfo* found;
+    if (getaddrinfo(NULL, port, &hints, &found) != 0) {
+        TraceLog(LOG_ERROR, "Cannot listen on port %s", port);
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo* candidate = found; candidate != NULL && fd < 0; candidate = candidate->ai_next) {
+        fd = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        if (fd < 0) continue;
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, candidate->ai_addr, candidate->ai_addrlen) != 0 || listen(fd, 1) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    if (fd < 0) {
+        TraceLog(LOG_ERROR, "Cannot listen on port %s: %s", port, strerror(errno));
+    }
+    return fd;
+}
+
+// Takes the connection of the band below, waiting up to NODE_CONNECT_SECONDS; -1 on failure
+int acceptNode(int listenFd) {
+    struct pollfd waiting = { listenFd, POLLIN, 0 };
+    int fd = -1;
+    if (poll(&waiting, 1, NODE_CONNECT_SECONDS * 1000) == 1) {
+        fd = accept(listenFd, NULL, NULL);
+    }
+    if (fd < 0) {
+        TraceLog(LOG_ERROR, "The node below did not connect");
+        return -1;
+    }
+    tuneLink(fd);
+    return fd;
+}
+
+// Connects to the band above at `address`, retrying while it starts up; -1 on failure
+int connectNode(const char* address) {
+    char host[256];
+    const char* port;
+    if (!splitAddress(address, host, sizeof(host), &port)) return -1;
+
+    struct addrinfo hints = {0};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    for (int attempt = 0; attempt < NODE_CONNECT_SECONDS * 10; attempt++) {
+        struct addrinfo* found;
+        if (getaddrinfo(host, port, &hints, &found) == 0) {
+            for (struct addrinfo* candidate = found; candidate != NULL; candidate = candidate->ai_next) {
+                int fd = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+                if (fd < 0) continue;
+                if (connect(fd, candidate->ai_addr, candidate->ai_addrlen) == 0) {
+                    freeaddrinfo(found);
+                    tuneLink(fd);
+                    return fd;
+                }
+                close(fd);
+            }
+            freeaddrinfo(found);
+        }
+        usleep(100000);
+    }
+    TraceLog(LOG_ERROR, "Cannot reach node %s", address);
+    return -1;
+}
+
+// Both ends of a link say which band they are and what world they step, so a node
+// started with the wrong list or source fails at once rather than mid-run
+bool greetNode(int fd, const Domain* domain, const BandRun* run, int peerIndex) {
+    int hello[4] = { domain->index, domain->count, run->width, run->height };
+    int peer[4];
+    if (!sendAll(fd, hello, sizeof(hello)) || !recvAll(fd, peer, sizeof(peer))) {
+        TraceLog(LOG_ERROR, "Lost node %d during the handshake", peerIndex);
+        return false;
+    }
+    if (peer[0] != peerIndex || peer[1] != domain->count || peer[2] != run->width || peer[3] != run->height) {
+        TraceLog(LOG_ERROR, "Node %d is band %d of %d over a %dx%d world; expected band %d of %d over %dx%d",
+                 peerIndex, peer[0], peer[1], peer[2], peer[3], peerIndex, domain->count, run->width, run->height);
+        return false;
+    }
+    return true;
+}
+
+// Runs band `index` of a run spread over machines, `addresses[i]` being where band i
+// listens for band i + 1. False if a link could not be made or the band failed.
+bool runNode(const BandRun* run, int index, char** addresses, int count) {
+    Domain domain;
+    planDomain(&domain, index, count, run->height);
 
-    if (acidGasCooldown[y][x] > 0) {
-        acidGasCooldown[y][x]--;
+    // Listening first lets the band below connect while this one waits on the band above
+    int listenFd = (index < count - 1) ? listenNode(addresses[index]) : -1;
+    bool ok = index == count - 1 || listenFd >= 0;
+    if (ok && index > 0) {
+        domain.upFd = connectNode(addresses[index - 1]);
+        ok = domain.upFd >= 0 && greetNode(domain.upFd, &domain, run, index - 1);
     }
+    if (ok && index < count - 1) {
+        domain.downFd = acceptNode(listenFd);
+        ok = domain.downFd >= 0 && greetNode(domain.downFd, &domain, run, index + 1);
+    }
+    if (listenFd >= 0) close(listenFd);
 
-    if (acidGasCooldown[y][x] == 0) {
-        if (y - 1 >= 0 && grid[y - 1][x] == EMPTY) {
-            grid[y - 1][x] = ACID_GAS;
-            acidTimer[y - 1][x] = acidTimer[y][x];
-            acidStage[y - 1][x] = acidStage[y][x];
-            acidGasCooldown[y - 1][x] = 5;
-            grid[y][x] = EMPTY;
-            acidTimer[y][x] = 0;
-            acidStage[y][x] = 0;
-            acidGasCooldown[y][x] = 0;
-            return true;
-        }
+    ok = ok && runBand(run, &domain);
+    if (domain.upFd >= 0) close(domain.upFd);
+    if (domain.downFd >= 0) close(domain.downFd);
+    return ok;
+}
 
-        int dir = (GetRandomValue(0, 1) == 0) ? -1 : 1;
-        if (x + dir >= 0 && x + dir < gridWidth && grid[y][x + dir] == EMPTY) {
-            grid[y][x + dir] = ACID_GAS;
-            acidTimer[y][x + dir] = acidTimer[y][x];
-            acidStage[y][x + dir] = acidStage[y][x];
-            acidGasCooldown[y][x + dir] = 5;
-            grid[y][x] = EMPTY;
-            acidTimer[y][x] = 0;
-            acidStage[y][x] = 0;
-            acidGasCooldown[y][x] = 0;
-            return true;
-        }
+// Steps `world` `ticks` ticks as `count` forked bands, for verification. The world
+// reaches the bands and comes back through checkpoints in a scratch directory,
+// the same way a multi-process run starts and ends. False if a band failed or the
+// result could not be read back.
+bool runDomainsOn(World* world, int count, long ticks) {
+    char dir[] = "/tmp/sandsim-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        TraceLog(LOG_ERROR, "Cannot make a scratch directory: %s", strerror(errno));
+        return false;
     }
+    int** planes[CHECKPOINT_PLANES];
+    worldPlanes(world, planes);
+    CheckpointWriter writer;
+    initCheckpoints(&writer, dir);
+    writeCheckpoint(&writer, world->height, world->width, planes, NULL, world->tick);
+    freeCheckpoints(&writer);
 
-    if (acidTimer[y][x] <= 0) {
-        grid[y][x] = EMPTY;
-        acidTimer[y][x] = 0;
-        acidStage[y][x] = 0;
-        acidGasCooldown[y][x] = 0;
-        return true;
+    BandRun run = { world->width, world->height, world->seed, dir, 0, false, 0,
+                    ticks, dir, (ticks > 0) ? (int)ticks : 1, 0 };
+    bool ok = runDomains(&run, count);
+    if (ok) {
+        int width;
+        int height;
+        int base = findCheckpointBase(dir, &width, &height);
+        long tick = (base < 0) ? -1 : restoreCheckpoints(dir, base, world->height, world->width, planes,
+                                                          0, world->height);
+        ok = tick >= 0;
+        world->tick = tick;
+        world->evaporationCounter = (int)(tick % EVAPORATION_TIME);
+        markAllChunksChanged(world);
+        refreshPopulations(world);
     }
 
-    return false;
+    char path[512];
+    for (int index = 0; ; index++) {
+        checkpointPath(path, sizeof(path), dir, index);
+        if (remove(path) != 0) break;
+    }
+    rmdir(dir);
+    return ok;
 }
 
-bool updateGas(int gridHeight, int gridWidth, int** grid, int** gasTimer, int** gasCooldown, int x, int y, int** fireTimer) {
-    int dirs[4][2] = {{0,1}, {1,0}, {0,-1}, {-1,0}};
-    for (int i = 0; i < 4; i++) {
-        int nx = x + dirs[i][0];
-        int ny = y + dirs[i][1];
-        if (nx >= 0 && nx < gridWidth && ny >= 0 && ny < gridHeight && grid[ny][nx] == FIRE) {
-            grid[y][x] = FIRE;
-            fireTimer[y][x] = 0;
-            gasTimer[y][x] = 0;
-            gasCooldown[y][x] = 0;
-            return true;
+// Batch runs: many independent worlds stepped side by side in one process, for
+// parameter sweeps. Each world owns its planes, clocks and seed, and the material,
+// reaction and colour tables are shared and only read while stepping. Worker
+// threads take whole worlds from a shared counter, one world per task.
+#define BATCH_MAX_THREADS 64
+#define BATCH_WORLD_SIZE 256
+
+typedef struct {
+    World* worlds;
+    int worldCount;
+    long ticks;
+    atomic_int next;            // Next world to hand out
+} Batch;
+
+void* batchWorker(void* arg) {
+    Batch* batch = (Batch*)arg;
+    int i;
+    while ((i = atomic_fetch_add(&batch->next, 1)) < batch->worldCount) {
+        for (long t = 0; t < batch->ticks; t++) {
+            stepWorld(&batch->worlds[i]);
         }
     }
+    return NULL;
+}
 
-    gasTimer[y][x]++;
+// Steps every world `ticks` ticks on up to `threadCount` threads; returns the number used
+int runBatch(World* worlds, int worldCount, long ticks, int threadCount) {
+    if (threadCount > worldCount) threadCount = worldCount;
+    if (threadCount > BATCH_MAX_THREADS) threadCount = BATCH_MAX_THREADS;
+    if (threadCount < 1) threadCount = 1;
 
-    if (gasCooldown[y][x] > 0) {
-        gasCooldown[y][x]--;
+    Batch batch = { worlds, worldCount, ticks, 0 };
+    pthread_t threads[BATCH_MAX_THREADS];
+    for (int i = 0; i < threadCount; i++) {
+        pthread_create(&threads[i], NULL, batchWorker, &batch);
     }
-
-    if (gasCooldown[y][x] > 0) {
-        return false;
+    for (int i = 0; i < threadCount; i++) {
+        pthread_join(threads[i], NULL);
     }
+    return threadCount;
+}
 
-    if (y - 1 >= 0 && grid[y - 1][x] == EMPTY) {
-        if (GetRandomValue(0, 100) < 60) {
-            grid[y - 1][x] = GAS;
-            gasTimer[y - 1][x] = gasTimer[y][x];
-            gasCooldown[y - 1][x] = 2;
-            grid[y][x] = EMPTY;
-            gasTimer[y][x] = 0;
-            gasCooldown[y][x] = 0;
-            return true;
-        }
-    }
+// Differential verification: the reference stepper applies the same rules as
+// stepWorld in the plainest way it can, every cell through the bounds-checked
+// kernel, no chunk skipping, full-grid scans, and the gas stencil worked out cell
+// by cell from a copy of the old field. `--verify N` steps it beside the optimized
+// stepper, and the distributed one when `--domains` is above 1, from the same
+// snapshot and seed, and reports the first tick and cell where they part.
+#define VERIFY_SEGMENT 50
 
-    int directions[8][2] = {
-        {-1, 0}, {1, 0}, {-1, -1}, {1, -1},
-        {-1, 1}, {1, 1}, {0, -1}, {0, 1}
-    };
+const char* planeNames[CHECKPOINT_PLANES] = {
+    "material", "acid stage", "acid timer", "fire timer", "gas density",
+    "acid gas density", "steam timer", "growth timer"
+};
 
-    for (int i = 0; i < 8; i++) {
-        int swapIndex = GetRandomValue(0, 7);
-        int tempX = directions[i][0];
-        int tempY = directions[i][1];
-        directions[i][0] = directions[swapIndex][0];
-        directions[i][1] = directions[swapIndex][1];
-        directions[swapIndex][0] = tempX;
-        directions[swapIndex][1] = tempY;
-    }
-
-    for (int i = 0; i < 8; i++) {
-        int dx = directions[i][0];
-        int dy = directions[i][1];
-        int nx = x + dx;
-        int ny = y + dy;
-
-        if (nx >= 0 && nx < gridWidth && ny >= 0 && ny < gridHeight && grid[ny][nx] == EMPTY) {
-            grid[ny][nx] = GAS;
-            gasTimer[ny][nx] = gasTimer[y][x];
-            gasCooldown[ny][nx] = 2;
-            grid[y][x] = EMPTY;
-            gasTimer[y][x] = 0;
-            gasCooldown[y][x] = 0;
-            return true;
+// Copies every plane and the clocks of `source` into a freshly created world
+void copyWorld(World* copy, World* source) {
+    createWorld(copy, source->width, source->height);
+    int** from[CHECKPOINT_PLANES];
+    int** to[CHECKPOINT_PLANES];
+    worldPlanes(source, from);
+    worldPlanes(copy, to);
+    for (int p = 0; p < CHECKPOINT_PLANES; p++) {
+        memcpy(to[p][0], from[p][0], (size_t)source->width * source->height * sizeof(int));
+    }
+    copy->seed = source->seed;
+    copy->tick = source->tick;
+    copy->evaporationCounter = source->evaporationCounter;
+}
+
+// The gas stencil for one plane, one cell at a time. Gas crossing a face leaves one
+// cell and enters the other, so before decay the field's total must not change;
+// returns false if it did. `stepped` gets the total the step left for transport.
+bool referenceGasPlane(World* world, int** plane, const int* old, const int* open, int decayShift,
+                       long* stepped) {
+    int width = world->width;
+    int height = world->height;
+    long before = 0;
+    long moved = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int i = y * width + x;
+            int c = old[i];
+            int o = open[i];
+            int d = c;
+            if (x > 0 && open[i - 1] && o) d += (old[i - 1] - c) / 8;
+            if (x < width - 1 && open[i + 1] && o) d += (old[i + 1] - c) / 8;
+            if (y < height - 1) d += gasRise(old[i + width], c, open[i + width], o);
+            if (y > 0) d -= gasRise(c, old[i - width], o, open[i - width]);
+            before += c;
+            moved += d;
+            d -= (d + (1 << decayShift) - 1) >> decayShift;
+            plane[y][x] = (d >= GAS_MIN) ? d : 0;
         }
     }
+    *stepped = before;
+    return before == moved;
+}
 
-    if (gasTimer[y][x] > 600) {
-        grid[y][x] = EMPTY;
-        gasTimer[y][x] = 0;
-        gasCooldown[y][x] = 0;
-        return true;
+bool referenceGasField(World* world, long stepped[2]) {
+    size_t cells = (size_t)world->width * world->height;
+    int* oldGas = (int *)malloc(cells * sizeof(int));
+    int* oldAcidGas = (int *)malloc(cells * sizeof(int));
+    int* open = (int *)calloc(cells, sizeof(int));
+    memcpy(oldGas, world->timerPlanes[PLANE_GAS_DENSITY][0], cells * sizeof(int));
+    memcpy(oldAcidGas, world->timerPlanes[PLANE_ACID_GAS_DENSITY][0], cells * sizeof(int));
+    for (size_t i = 0; i < cells; i++) {
+        open[i] = gasOpen(world->grid[0][i]);
     }
 
-    gasCooldown[y][x] = 2;
-    return false;
-}
+    bool conserved = referenceGasPlane(world, world->timerPlanes[PLANE_GAS_DENSITY], oldGas, open, GAS_DECAY_SHIFT,
+                                       &stepped[0]);
+    conserved &= referenceGasPlane(world, world->timerPlanes[PLANE_ACID_GAS_DENSITY], oldAcidGas, open,
+                                   ACID_GAS_DECAY_SHIFT, &stepped[1]);
 
-bool updateFire(int gridHeight, int gridWidth, int** grid, int** fireTimer, int** steamTimer, int x, int y) {
-    fireTimer[y][x]++;
-    
-    for (int dy = -1; dy <= 1; dy++) {
-        for (int dx = -1; dx <= 1; dx++) {
-            if (dx == 0 && dy == 0) continue;
-            int nx = x + dx;
-            int ny = y + dy;
-            if (nx >= 0 && nx < gridWidth && ny >= 0 && ny < gridHeight) {
-                if (grid[ny][nx] == WATER) {
-                    grid[ny][nx] = STEAM;
-                    steamTimer[ny][nx] = 0;
-                }
-                else if (grid[ny][nx] == STEAM) {
-                    grid[ny][nx] = EMPTY;
-                    steamTimer[ny][nx] = 0;
-                }
-            }
+    for (size_t i = 0; i < cells; i++) {
+        if (!open[i]) {
+            continue;
+        }
+        if (world->timerPlanes[PLANE_GAS_DENSITY][0][i] >= GAS_VISIBLE) {
+            world->grid[0][i] = GAS;
+        } else if (world->timerPlanes[PLANE_ACID_GAS_DENSITY][0][i] >= GAS_VISIBLE) {
+            world->grid[0][i] = ACID_GAS;
+        } else {
+            world->grid[0][i] = EMPTY;
         }
     }
 
-    if (GetRandomValue(0, 100) < 50) {
-        int moveX = x + GetRandomValue(-1, 1);
-        int moveY = y - 1;
+    free(oldGas);
+    free(oldAcidGas);
+    free(open);
+    return conserved;
+}
 
-        if (moveX >= 0 && moveX < gridWidth && moveY >= 0 && moveY < gridHeight) {
-            if (grid[moveY][moveX] == EMPTY) {
-                grid[moveY][moveX] = FIRE;
-                fireTimer[moveY][moveX] = fireTimer[y][x];
-                grid[y][x] = EMPTY;
-                fireTimer[y][x] = 0;
-                return true;
+// One tick by the reference rules; false if the gas field lost or gained mass in
+// transport. `stepped` gets each gas plane's total as the step left it.
+bool referenceStep(World* world, long stepped[2]) {
+    int gridWidth = world->width;
+    int gridHeight = world->height;
+    int** grid = world->grid;
+    bool** updated = world->updated;
+    memset(updated[0], 0, (size_t)gridWidth * gridHeight * sizeof(bool));
+    world->growthBudget = GROWTH_BUDGET;
+    long growthDue = LONG_MAX;
+
+    for (int y = gridHeight - 1; y >= 0; y--) {
+        int growthFloor = rowGrowthFloor(world->tick, y, gridHeight);
+        int step = ((y + world->tick) & 1) ? -1 : 1;
+        int x = (step > 0) ? 0 : gridWidth - 1;
+        for (int i = 0; i < gridWidth; i++, x += step) {
+            if (updated[y][x]) {
+                continue;
+            }
+            int ahead = x + step;
+            bool hasAhead = ahead >= 0 && ahead < gridWidth;
+            int aheadBefore = hasAhead ? grid[y][ahead] : EMPTY;
+
+            seedCellRandom(world->seed, world->tick, x, y);
+            updated[y][x] = stepEdgeCell(gridHeight, gridWidth, grid, world->timerPlanes, 0, gridHeight,
+                                         &world->growthBudget, growthFloor, world->tick, &growthDue, x, y);
+            if (updated[y][x] && hasAhead && grid[y][ahead] != aheadBefore) {
+                updated[y][ahead] = true;
             }
         }
     }
 
-    if (fireTimer[y][x] > 30) {
-        grid[y][x] = EMPTY;
-        fireTimer[y][x] = 0;
-        return true;
+    if (evaporationDue(world)) {
+        int evaporated = 0;
+        for (int y = 0; y < gridHeight && evaporated < MAX_EVAPORATIONS_PER_TICK; y++) {
+            for (int x = 0; x < gridWidth && evaporated < MAX_EVAPORATIONS_PER_TICK; x++) {
+                if (grid[y][x] == ACID && world->timerPlanes[PLANE_ACID_TIMER][y][x] >= EVAPORATION_TIME) {
+                    grid[y][x] = EMPTY;
+                    world->timerPlanes[PLANE_ACID_STAGE][y][x] = 0;
+                    world->timerPlanes[PLANE_ACID_TIMER][y][x] = 0;
+                    evaporated++;
+                }
+            }
+        }
     }
 
-    return false;
+    bool conserved = referenceGasField(world, stepped);
+    world->tick++;
+    return conserved;
 }
 
-bool updateSteam(int gridHeight, int gridWidth, int** grid, int** steamTimer, int x, int y) {
-    steamTimer[y][x]++;
-    
-    if (steamTimer[y][x] > 1000 && steamTimer[y][x] < 1100 && 
-        y < gridHeight/2 && GetRandomValue(0, 100) < 2) {
-        if (y+1 < gridHeight && grid[y+1][x] == EMPTY) {
-            grid[y+1][x] = RAIN;
-            return true;
-        }
-    }
-    
-    int riseChance = 70;
-    if (GetRandomValue(0, 100) < riseChance && y > 0) {
-        int dir = GetRandomValue(0, 2) - 1;
-        int newX = x + dir;
-        int newY = y - 1;
-        
-        if (newX >= 0 && newX < gridWidth && newY >= 0) {
-            if (grid[newY][newX] == EMPTY || grid[newY][newX] == WATER) {
-                int targetMaterial = grid[newY][newX];
-                grid[newY][newX] = STEAM;
-                steamTimer[newY][newX] = steamTimer[y][x];
-                
-                grid[y][x] = targetMaterial;
-                steamTimer[y][x] = 0;
-                return true;
+// Reports the first cell, in checkpoint plane order, where `engine` differs from the reference
+bool compareWorlds(World* reference, World* engine, const char* engineName) {
+    int** expected[CHECKPOINT_PLANES];
+    int** actual[CHECKPOINT_PLANES];
+    worldPlanes(reference, expected);
+    worldPlanes(engine, actual);
+    for (int p = 0; p < CHECKPOINT_PLANES; p++) {
+        for (int y = 0; y < reference->height; y++) {
+            if (memcmp(expected[p][y], actual[p][y], reference->width * sizeof(int)) == 0) {
+                continue;
+            }
+            for (int x = 0; x < reference->width; x++) {
+                if (expected[p][y][x] != actual[p][y][x]) {
+                    TraceLog(LOG_ERROR, "VERIFY: %s stepper diverges at tick %ld, cell (%d, %d), %s: %d, reference %d",
+                             engineName, reference->tick, x, y, planeNames[p], actual[p][y][x], expected[p][y][x]);
+                    return false;
+                }
             }
         }
     }
-    
-    if (GetRandomValue(0, 100) < 40) {
-        int dir = (GetRandomValue(0, 1) == 0) ? -1 : 1;
-        int newX = x + dir;
-        
-        if (newX >= 0 && newX < gridWidth) {
-            if (grid[y][newX] == EMPTY || grid[y][newX] == WATER) {
-                int targetMaterial = grid[y][newX];
-                grid[y][newX] = STEAM;
-                steamTimer[y][newX] = steamTimer[y][x];
-                
-                grid[y][x] = targetMaterial;
-                steamTimer[y][x] = 0;
-                return true;
-            }
+    return true;
+}
+
+// Checks the optimized stepper's running material counts against a full count of the reference
+bool comparePopulations(World* reference, World* engine) {
+    long counts[MATERIAL_COUNT] = {0};
+    size_t cells = (size_t)reference->width * reference->height;
+    for (size_t i = 0; i < cells; i++) {
+        counts[reference->grid[0][i]]++;
+    }
+    for (int m = 0; m < MATERIAL_COUNT; m++) {
+        if (counts[m] != engine->population[m]) {
+            TraceLog(LOG_ERROR, "VERIFY: %s count is %ld at tick %ld, reference has %ld",
+                     materialNames[m], engine->population[m], reference->tick, counts[m]);
+            return false;
         }
     }
-    
-    if (steamTimer[y][x] > 1100) {
-        grid[y][x] = EMPTY;
-        steamTimer[y][x] = 0;
-        return true;
+    return true;
+}
+
+long planeTotal(int** plane, World* world) {
+    long total = 0;
+    for (size_t i = 0; i < (size_t)world->width * world->height; i++) {
+        total += plane[0][i];
     }
-    
-    return false;
+    return total;
 }
 
-bool updateRain(int gridHeight, int gridWidth, int** grid, int x, int y) {
-    if (y+1 < gridHeight) {
-        if (grid[y+1][x] == EMPTY) {
-            grid[y+1][x] = RAIN;
-            grid[y][x] = EMPTY;
-            return true;
-        }
-        else if (grid[y+1][x] != RAIN) {
-            grid[y][x] = WATER;
-            return true;
-        }
+// Decay is gas's only sink and takes at least 1/2^shift of each cell, rounded up,
+// every tick. `bound` is the most a plane can hold: what it could hold last tick,
+// plus whatever the step added, less that decay. Once it falls below GAS_MIN every
+// cell must have been cleared. False if the plane holds more than the bound.
+bool checkGasDecay(long* bound, long previous, long stepped, long now, int decayShift) {
+    if (stepped > previous) {
+        *bound += stepped - previous;
     }
-    else {
-        grid[y][x] = WATER;
-        return true;
+    *bound -= (*bound + (1 << decayShift) - 1) >> decayShift;
+    if (*bound < GAS_MIN) {
+        *bound = 0;
     }
-    
-    return false;
+    return now <= *bound;
 }
 
-bool updateGrassSeed(int gridHeight, int gridWidth, int** grid, int x, int y) {
-    // Falling behavior
-    if (y+1 < gridHeight) {
-        if (grid[y+1][x] == EMPTY) {
-            grid[y+1][x] = GRASS_SEED;
-            grid[y][x] = EMPTY;
-            return true;
+// Steps the reference and the optimized stepper `ticks` ticks from `start`, and
+// the distributed stepper in segments when domainCount is above 1. True if they agree.
+bool verifyEngines(World* start, long ticks, int domainCount) {
+    World reference;
+    World optimized;
+    World distributed;
+    copyWorld(&reference, start);
+    copyWorld(&optimized, start);
+    copyWorld(&distributed, start);
+    refreshPopulations(&optimized);
+
+    long startCounts[MATERIAL_COUNT];
+    memcpy(startCounts, optimized.population, sizeof(startCounts));
+    long startGas = planeTotal(reference.timerPlanes[PLANE_GAS_DENSITY], &reference);
+    long startAcidGas = planeTotal(reference.timerPlanes[PLANE_ACID_GAS_DENSITY], &reference);
+
+    bool agree = true;
+    long endTick = start->tick + ticks;
+    int** gasPlanes[2] = { reference.timerPlanes[PLANE_GAS_DENSITY], reference.timerPlanes[PLANE_ACID_GAS_DENSITY] };
+    int decayShifts[2] = { GAS_DECAY_SHIFT, ACID_GAS_DECAY_SHIFT };
+    long gasMass[2] = { startGas, startAcidGas };
+    long gasBound[2] = { startGas, startAcidGas };
+    while (agree && reference.tick < endTick) {
+        long stepped[2];
+        if (!referenceStep(&reference, stepped)) {
+            TraceLog(LOG_ERROR, "VERIFY: gas transport changed the field's mass at tick %ld", reference.tick);
+            agree = false;
         }
-        else if (grid[y+1][x] == WATER || grid[y+1][x] == GAS || grid[y+1][x] == ACID_GAS) {
-            int temp = grid[y+1][x];
-            grid[y+1][x] = GRASS_SEED;
-            grid[y][x] = temp;
-            return true;
+        for (int p = 0; p < 2; p++) {
+            long mass = planeTotal(gasPlanes[p], &reference);
+            if (!checkGasDecay(&gasBound[p], gasMass[p], stepped[p], mass, decayShifts[p])) {
+                TraceLog(LOG_ERROR, "VERIFY: %s holds %ld at tick %ld, decay allows at most %ld",
+                         planeNames[PLANE_GAS_DENSITY + 1 + p], mass, reference.tick, gasBound[p]);
+                agree = false;
+            }
+            gasMass[p] = mass;
+        }
+        stepWorld(&optimized);
+        agree = agree && compareWorlds(&reference, &optimized, "optimized") &&
+                comparePopulations(&reference, &optimized);
+
+        if (agree && domainCount > 1 &&
+            ((reference.tick - start->tick) % VERIFY_SEGMENT == 0 || reference.tick == endTick)) {
+            agree = runDomainsOn(&distributed, domainCount, reference.tick - distributed.tick) &&
+                    compareWorlds(&reference, &distributed, "distributed");
         }
     }
-    
-    // Check if seed is on top of dirt
-    if (y+1 < gridHeight && grid[y+1][x] == DIRT) {
-        // Convert seed to grass
-        grid[y][x] = GRASS;
-        
-        // Grow grass upward (max 6 cells)
-        int currentY = y-1;
-        int grassCount = 0;
-        while (grassCount < 6 && currentY >= 0) {
-            if (grid[currentY][x] == EMPTY) {
-                grid[currentY][x] = GRASS;
-                grassCount++;
-                currentY--;
-            } else {
-                break;
-            }
+
+    // What each material gained or lost over the run, for comparing against what the rules allow
+    TraceLog(LOG_INFO, "VERIFY: %ld ticks from tick %ld, %s", reference.tick - start->tick, start->tick,
+             agree ? "all steppers agree" : "steppers disagree");
+    for (int m = 0; m < MATERIAL_COUNT; m++) {
+        if (startCounts[m] != 0 || optimized.population[m] != 0) {
+            TraceLog(LOG_INFO, "VERIFY:   %-10s %8ld -> %8ld", materialNames[m], startCounts[m], optimized.population[m]);
         }
-        return true;
     }
-    
-    return false;
+    TraceLog(LOG_INFO, "VERIFY:   gas mass %ld -> %ld, acid gas mass %ld -> %ld", startGas,
+             planeTotal(reference.timerPlanes[PLANE_GAS_DENSITY], &reference), startAcidGas,
+             planeTotal(reference.timerPlanes[PLANE_ACID_GAS_DENSITY], &reference));
+
+    destroyWorld(&reference);
+    destroyWorld(&optimized);
+    destroyWorld(&distributed);
+    return agree;
 }
 
-int main() {
+int main(int argc, char** argv) {
     const int initialWidth = 800;
     const int initialHeight = 600;
     const int gridSize = 10;
@@ -563,45 +3514,292 @@ int main() {
     const int buttonHeight = 40;
     const int buttonSpacing = 10;
 
-    SetConfigFlags(FLAG_WINDOW_RESIZABLE);
-    InitWindow(initialWidth, initialHeight, "Sand Simulation with Elements");
-
-    int gridWidth = (initialWidth - 150) / gridSize;
+    int gridWidth = (initialWidth - TOOLBAR_WIDTH) / gridSize;
     int gridHeight = initialHeight / gridSize;
 
-    int **grid = (int **)malloc(gridHeight * sizeof(int *));
-    int **acidStage = (int **)malloc(gridHeight * sizeof(int *));
-    int **acidTimer = (int **)malloc(gridHeight * sizeof(int *));
-    int **fireTimer = (int **)malloc(gridHeight * sizeof(int *));
-    int **gasTimer = (int **)malloc(gridHeight * sizeof(int *));
-    int **gasCooldown = (int **)malloc(gridHeight * sizeof(int *));
-    int **acidGasCooldown = (int **)malloc(gridHeight * sizeof(int *));
-    int **steamTimer = (int **)malloc(gridHeight * sizeof(int *));
-    bool **updated = (bool **)malloc(gridHeight * sizeof(bool *));
+    // A world size given on the command line stays fixed; otherwise the grid follows the window
+    bool fixedWorld = false;
+    const char* capturePath = NULL;
+    int captureInterval = 10;
+    const char* checkpointDir = NULL;
+    const char* restoreDir = NULL;
+    int checkpointInterval = 300;
+    bool headless = false;
+    long headlessTicks = 0;
+    long verifyTicks = 0;
+    int batchCount = 0;
+    int threadCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int domainCount = 1;
+    int nodeIndex = -1;
+    int nodeCount = 0;
+    char** nodeAddresses = NULL;
+    bool seeded = false;
+    unsigned int seed = 1;
+    bool generate = false;
+    unsigned int generateSeed = 0;
+    int metricsPort = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (i + 1 >= argc) {
+            break;
+        } else if (strcmp(argv[i], "--ticks") == 0) {
+            headlessTicks = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            verifyTicks = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batchCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threadCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--domains") == 0) {
+            domainCount = atoi(argv[++i]);
+            if (domainCount < 1) domainCount = 1;
+        } else if (strcmp(argv[i], "--node") == 0) {
+            nodeIndex = atoi(argv[++i]);
+            headless = true;
+        } else if (strcmp(argv[i], "--nodes") == 0) {
+            // host:port of every band in order; each band listens on its own for the next
+            char* list = argv[++i];
+            nodeCount = 1;
+            for (char* c = list; *c != '\0'; c++) {
+                if (*c == ',') nodeCount++;
+            }
+            free(nodeAddresses);
+            nodeAddresses = (char **)malloc(nodeCount * sizeof(char*));
+            nodeAddresses[0] = list;
+            for (int n = 1; n < nodeCount; n++) {
+                nodeAddresses[n] = strchr(nodeAddresses[n - 1], ',');
+                *nodeAddresses[n]++ = '\0';
+            }
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+            seeded = true;
+        } else if (strcmp(argv[i], "--generate") == 0) {
+            generateSeed = (unsigned int)strtoul(argv[++i], NULL, 10);
+            generate = true;
+        } else if (strcmp(argv[i], "--width") == 0) {
+            gridWidth = atoi(argv[++i]);
+            fixedWorld = true;
+        } else if (strcmp(argv[i], "--height") == 0) {
+            gridHeight = atoi(argv[++i]);
+            fixedWorld = true;
+        } else if (strcmp(argv[i], "--capture") == 0) {
+            capturePath = argv[++i];
+        } else if (strcmp(argv[i], "--capture-every") == 0) {
+            captureInterval = atoi(argv[++i]);
+            if (captureInterval < 1) captureInterval = 1;
+        } else if (strcmp(argv[i], "--checkpoint") == 0) {
+            checkpointDir = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-every") == 0) {
+            checkpointInterval = atoi(argv[++i]);
+            if (checkpointInterval < 1) checkpointInterval = 1;
+        } else if (strcmp(argv[i], "--restore") == 0) {
+            restoreDir = argv[++i];
+        } else if (strcmp(argv[i], "--metrics") == 0) {
+            metricsPort = atoi(argv[++i]);
+        }
+    }
+
+    int restoreBase = -1;
+    if (restoreDir != NULL) {
+        restoreBase = findCheckpointBase(restoreDir, &gridWidth, &gridHeight);
+        if (restoreBase < 0) {
+            TraceLog(LOG_WARNING, "No checkpoint to restore in %s", restoreDir);
+        } else {
+            fixedWorld = true;
+        }
+    }
+    if (batchCount > 0 && !fixedWorld) {
+        gridWidth = BATCH_WORLD_SIZE;
+        gridHeight = BATCH_WORLD_SIZE;
+    }
+    if (gridWidth < 1) gridWidth = 1;
+    if (gridHeight < 1) gridHeight = 1;
+    if (domainCount > maxDomains(gridHeight)) domainCount = maxDomains(gridHeight);
+
+    loadReactions(REACTION_FILE);
+    compileReactions();
+    buildColorTables();
 
-    for (int y = 0; y < gridHeight; y++) {
-        grid[y] = (int *)malloc(gridWidth * sizeof(int));
-        acidStage[y] = (int *)malloc(gridWidth * sizeof(int));
-        acidTimer[y] = (int *)malloc(gridWidth * sizeof(int));
-        fireTimer[y] = (int *)malloc(gridWidth * sizeof(int));
-        gasTimer[y] = (int *)malloc(gridWidth * sizeof(int));
-        gasCooldown[y] = (int *)malloc(gridWidth * sizeof(int));
-        acidGasCooldown[y] = (int *)malloc(gridWidth * sizeof(int));
-        steamTimer[y] = (int *)malloc(gridWidth * sizeof(int));
-        updated[y] = (bool *)malloc(gridWidth * sizeof(bool));
-        for (int x = 0; x < gridWidth; x++) {
-            grid[y][x] = EMPTY;
-            acidStage[y][x] = 0;
-            acidTimer[y][x] = 0;
-            fireTimer[y][x] = 0;
-            gasTimer[y][x] = 0;
-            gasCooldown[y][x] = 0;
-            acidGasCooldown[y][x] = 0;
-            steamTimer[y][x] = 0;
-            updated[y][x] = false;
+    // Multi-process runs: every band loads or generates its own rows in its own
+    // process, so the whole world is never built here
+    if (headless && verifyTicks == 0 && batchCount == 0 && (nodeIndex >= 0 || domainCount > 1)) {
+        BandRun run = { gridWidth, gridHeight, seed, (restoreBase >= 0) ? restoreDir : NULL, restoreBase,
+                        generate, generateSeed, headlessTicks, checkpointDir, checkpointInterval, metricsPort };
+        if (capturePath != NULL) {
+            TraceLog(LOG_WARNING, "Capture needs whole frames and is not available in multi-process runs");
+        }
+        bool ok;
+        if (nodeIndex < 0) {
+            ok = runDomains(&run, domainCount);
+        } else if (nodeIndex >= nodeCount || nodeCount > maxDomains(gridHeight)) {
+            TraceLog(LOG_ERROR, "Node %d of %d: a world %d rows tall takes 1 to %d nodes", nodeIndex, nodeCount,
+                     gridHeight, maxDomains(gridHeight));
+            ok = false;
+        } else {
+            ok = runNode(&run, nodeIndex, nodeAddresses, nodeCount);
+        }
+        free(nodeAddresses);
+        return ok ? 0 : 1;
+    }
+    free(nodeAddresses);
+
+    World world;
+    createWorld(&world, gridWidth, gridHeight);
+    world.publishes = true;
+    if (generate && restoreBase < 0) {
+        generateWorld(&world, generateSeed);
+    }
+
+    if (restoreBase >= 0) {
+        int** planes[CHECKPOINT_PLANES];
+        worldPlanes(&world, planes);
+        world.tick = restoreCheckpoints(restoreDir, restoreBase, gridHeight, gridWidth, planes, 0, gridHeight);
+        if (world.tick < 0) {
+            destroyWorld(&world);
+            return 1;
+        }
+        world.evaporationCounter = world.tick % EVAPORATION_TIME;
+    }
+
+    CheckpointWriter checkpoints;
+    if (checkpointDir != NULL) {
+        int** planes[CHECKPOINT_PLANES];
+        worldPlanes(&world, planes);
+        initCheckpoints(&checkpoints, checkpointDir);
+        writeCheckpoint(&checkpoints, gridHeight, gridWidth, planes, world.chunkUnsaved, world.tick);
+    }
+
+    CaptureStream capture;
+    bool capturing = capturePath != NULL && startCapture(&capture, capturePath, gridWidth, gridHeight);
+
+    MetricsServer metrics;
+    bool serving = metricsPort > 0 && startMetricsServer(&metrics, metricsPort);
+    refreshPopulations(&world);
+    publishTelemetry(&world);
+
+    // Verification: compare the steppers from this snapshot, then exit
+    if (verifyTicks > 0) {
+        world.seed = seed;
+        bool agree = verifyEngines(&world, verifyTicks, domainCount);
+        if (serving) {
+            stopMetricsServer(&metrics);
+        }
+        destroyWorld(&world);
+        if (capturing) {
+            stopCapture(&capture);
+        }
+        if (checkpointDir != NULL) {
+            freeCheckpoints(&checkpoints);
+        }
+        return agree ? 0 : 1;
+    }
+
+    // Batch: step many copies of the starting world, each with its own seed (and its
+    // own terrain when generating), and write each one's final checkpoint
+    if (batchCount > 0) {
+        World* worlds = (World *)malloc(batchCount * sizeof(World));
+        for (int i = 0; i < batchCount; i++) {
+            copyWorld(&worlds[i], &world);
+            if (generate && restoreBase < 0 && i > 0) {
+                generateWorld(&worlds[i], generateSeed + i);
+            }
+            worlds[i].seed = seed + i;
+        }
+
+        long start = nowNanos();
+        threadCount = runBatch(worlds, batchCount, headlessTicks, threadCount);
+        double seconds = (nowNanos() - start) / 1e9;
+        TraceLog(LOG_INFO, "Batch: %d worlds of %dx%d, %ld ticks on %d threads in %.2f s (%.0f world ticks/s)",
+                 batchCount, gridWidth, gridHeight, headlessTicks, threadCount, seconds,
+                 seconds > 0.0 ? batchCount * headlessTicks / seconds : 0.0);
+
+        for (int i = 0; i < batchCount; i++) {
+            if (checkpointDir != NULL) {
+                char dir[512];
+                snprintf(dir, sizeof(dir), "%s/world%d", checkpointDir, i);
+                CheckpointWriter writer;
+                initCheckpoints(&writer, dir);
+                int** planes[CHECKPOINT_PLANES];
+                worldPlanes(&worlds[i], planes);
+                writeCheckpoint(&writer, gridHeight, gridWidth, planes, NULL, worlds[i].tick);
+                freeCheckpoints(&writer);
+            }
+            destroyWorld(&worlds[i]);
+        }
+        free(worlds);
+
+        if (serving) {
+            stopMetricsServer(&metrics);
+        }
+        destroyWorld(&world);
+        if (capturing) {
+            stopCapture(&capture);
+        }
+        if (checkpointDir != NULL) {
+            freeCheckpoints(&checkpoints);
+        }
+        return 0;
+    }
+
+    // Headless: step a fixed number of ticks without a window
+    if (headless) {
+        world.seed = seed;
+        long endTick = world.tick + headlessTicks;
+        while (world.tick < endTick) {
+            long steps = endTick - world.tick;
+            if (checkpointDir != NULL && steps > checkpointInterval - world.tick % checkpointInterval) {
+                steps = checkpointInterval - world.tick % checkpointInterval;
+            }
+            if (capturing && steps > captureInterval - world.tick % captureInterval) {
+                steps = captureInterval - world.tick % captureInterval;
+            }
+            for (long i = 0; i < steps; i++) {
+                stepWorld(&world);
+            }
+
+            long start = nowNanos();
+            if (checkpointDir != NULL && (world.tick % checkpointInterval == 0 || world.tick == endTick)) {
+                int** planes[CHECKPOINT_PLANES];
+                worldPlanes(&world, planes);
+                writeCheckpoint(&checkpoints, gridHeight, gridWidth, planes, world.chunkUnsaved, world.tick);
+                addPhaseTime(PHASE_CHECKPOINT, start);
+            }
+            start = nowNanos();
+            if (capturing && world.tick % captureInterval == 0) {
+                captureFrame(&capture, gridHeight, gridWidth, world.grid, world.tick);
+                addPhaseTime(PHASE_CAPTURE, start);
+            }
+        }
+
+        if (serving) {
+            stopMetricsServer(&metrics);
+        }
+        destroyWorld(&world);
+        if (capturing) {
+            stopCapture(&capture);
+        }
+        if (checkpointDir != NULL) {
+            freeCheckpoints(&checkpoints);
         }
+        return 0;
     }
 
+    SetConfigFlags(FLAG_WINDOW_RESIZABLE);
+    InitWindow(initialWidth, initialHeight, "Sand Simulation with Elements");
+    world.seed = seeded ? seed : (unsigned int)GetRandomValue(1, 0x7fffffff);
+
+    // Camera: world cell shown at the top-left of the view, and pixels per cell
+    float cameraX = 0.0f;
+    float cameraY = 0.0f;
+    float zoom = gridSize;
+
+    // Screen-sized texture used when zoomed out past LOD_MIN_ZOOM
+    Texture2D viewTexture = { 0 };
+    Color *viewPixels = NULL;
+    int viewTextureWidth = 0;
+    int viewTextureHeight = 0;
+
     Rectangle sandButton = { buttonSpacing, buttonSpacing, buttonWidth, buttonHeight };
     Rectangle waterButton = { buttonSpacing, buttonSpacing*2 + buttonHeight, buttonWidth, buttonHeight };
     Rectangle stoneButton = { buttonSpacing, buttonSpacing*3 + buttonHeight*2, buttonWidth, buttonHeight };
@@ -616,9 +3814,6 @@ int main() {
     int currentMaterial = SAND;
     int brushSize = 3;
     int framesCounter = 0;
-    int evaporationCounter = 0;
-    const int evaporationTime = 20 * 60;
-    const int maxEvaporationsPerFrame = 10;
 
     SetTargetFPS(60);
 
@@ -626,69 +3821,31 @@ int main() {
         if (IsWindowResized()) {
             int newWidth = GetScreenWidth();
             int newHeight = GetScreenHeight();
-            int newGridWidth = (newWidth - 150) / gridSize;
+            int newGridWidth = (newWidth - TOOLBAR_WIDTH) / gridSize;
             int newGridHeight = newHeight / gridSize;
 
-            if (newGridWidth != gridWidth || newGridHeight != gridHeight) {
-                for (int y = 0; y < gridHeight; y++) {
-                    free(grid[y]);
-                    free(acidStage[y]);
-                    free(acidTimer[y]);
-                    free(fireTimer[y]);
-                    free(gasTimer[y]);
-                    free(gasCooldown[y]);
-                    free(acidGasCooldown[y]);
-                    free(steamTimer[y]);
-                    free(updated[y]);
-                }
-                free(grid);
-                free(acidStage);
-                free(acidTimer);
-                free(fireTimer);
-                free(gasTimer);
-                free(gasCooldown);
-                free(acidGasCooldown);
-                free(steamTimer);
-                free(updated);
-
+            if (!fixedWorld && (newGridWidth != gridWidth || newGridHeight != gridHeight)) {
                 gridWidth = newGridWidth;
                 gridHeight = newGridHeight;
-
-                grid = (int **)malloc(gridHeight * sizeof(int *));
-                acidStage = (int **)malloc(gridHeight * sizeof(int *));
-                acidTimer = (int **)malloc(gridHeight * sizeof(int *));
-                fireTimer = (int **)malloc(gridHeight * sizeof(int *));
-                gasTimer = (int **)malloc(gridHeight * sizeof(int *));
-                gasCooldown = (int **)malloc(gridHeight * sizeof(int *));
-                acidGasCooldown = (int **)malloc(gridHeight * sizeof(int *));
-                steamTimer = (int **)malloc(gridHeight * sizeof(int *));
-                updated = (bool **)malloc(gridHeight * sizeof(bool *));
-
-                for (int y = 0; y < gridHeight; y++) {
-                    grid[y] = (int *)malloc(gridWidth * sizeof(int));
-                    acidStage[y] = (int *)malloc(gridWidth * sizeof(int));
-                    acidTimer[y] = (int *)malloc(gridWidth * sizeof(int));
-                    fireTimer[y] = (int *)malloc(gridWidth * sizeof(int));
-                    gasTimer[y] = (int *)malloc(gridWidth * sizeof(int));
-                    gasCooldown[y] = (int *)malloc(gridWidth * sizeof(int));
-                    acidGasCooldown[y] = (int *)malloc(gridWidth * sizeof(int));
-                    steamTimer[y] = (int *)malloc(gridWidth * sizeof(int));
-                    updated[y] = (bool *)malloc(gridWidth * sizeof(bool));
-                    for (int x = 0; x < gridWidth; x++) {
-                        grid[y][x] = EMPTY;
-                        acidStage[y][x] = 0;
-                        acidTimer[y][x] = 0;
-                        fireTimer[y][x] = 0;
-                        gasTimer[y][x] = 0;
-                        gasCooldown[y][x] = 0;
-                        acidGasCooldown[y][x] = 0;
-                        steamTimer[y][x] = 0;
-                        updated[y][x] = false;
-                    }
-                }
+                carveWorld(&world, gridWidth, gridHeight);
+                cameraX = 0.0f;
+                cameraY = 0.0f;
             }
         }
 
+        int** grid = world.grid;
+        int*** timerPlanes = world.timerPlanes;
+        int** acidStage = timerPlanes[PLANE_ACID_STAGE];
+        int** acidTimer = timerPlanes[PLANE_ACID_TIMER];
+        int** fireTimer = timerPlanes[PLANE_FIRE_TIMER];
+        int** gasDensity = timerPlanes[PLANE_GAS_DENSITY];
+        int** acidGasDensity = timerPlanes[PLANE_ACID_GAS_DENSITY];
+        int** steamTimer = timerPlanes[PLANE_STEAM_TIMER];
+        bool* chunkDirty = world.chunkDirty;
+        Color* chunkLod = world.chunkLod;
+        int chunksX = world.chunksX;
+        int chunksY = world.chunksY;
+
         Vector2 mousePos = GetMousePosition();
 
         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
@@ -714,18 +3871,7 @@ int main() {
                 currentMaterial = EMPTY;
             }
             else if (CheckCollisionPointRec(mousePos, eraseAllButton)) {
-                for (int y = 0; y < gridHeight; y++) {
-                    for (int x = 0; x < gridWidth; x++) {
-                        grid[y][x] = EMPTY;
-                        acidStage[y][x] = 0;
-                        acidTimer[y][x] = 0;
-                        fireTimer[y][x] = 0;
-                        gasTimer[y][x] = 0;
-                        gasCooldown[y][x] = 0;
-                        acidGasCooldown[y][x] = 0;
-                        steamTimer[y][x] = 0;
-                    }
-                }
+                clearWorld(&world);
             }
             else if (CheckCollisionPointRec(mousePos, dirtButton)) {
                 currentMaterial = DIRT;
@@ -735,9 +3881,11 @@ int main() {
             }
         }
 
-        if (IsMouseButtonDown(MOUSE_LEFT_BUTTON) && mousePos.x > 150) {
-            int gridX = (mousePos.x - 150) / gridSize;
-            int gridY = mousePos.y / gridSize;
+        if (IsMouseButtonDown(MOUSE_LEFT_BUTTON) && mousePos.x > TOOLBAR_WIDTH) {
+            int gridX = (int)floorf(cameraX + (mousePos.x - TOOLBAR_WIDTH) / zoom);
+            int gridY = (int)floorf(cameraY + mousePos.y / zoom);
+            int reach = (currentMaterial == FIRE) ? brushSize * 2 : brushSize / 2;
+            markChunksChanged(&world, gridX - reach - 1, gridY - reach - 1, gridX + reach + 1, gridY + reach);
 
             if (currentMaterial == FIRE) {
                 if (gridY >= 0 && gridY < gridHeight && gridX >= 0 && gridX < gridWidth) {
@@ -777,8 +3925,7 @@ int main() {
                             if (currentMaterial == GAS) {
                                 if (grid[y][x] != STONE && grid[y][x] != ACID && grid[y][x] != GRASS_SEED) {
                                     grid[y][x] = GAS;
-                                    gasTimer[y][x] = 0;
-                                    gasCooldown[y][x] = 0;
+                                    gasDensity[y][x] = GAS_UNIT;
                                 }
                             }
                             else if (currentMaterial == ACID) {
@@ -786,7 +3933,6 @@ int main() {
                                     grid[y][x] = ACID;
                                     acidStage[y][x] = 0;
                                     acidTimer[y][x] = 0;
-                                    acidGasCooldown[y][x] = 0;
                                 }
                             }
                             else if (currentMaterial == EMPTY) {
@@ -794,9 +3940,8 @@ int main() {
                                 acidStage[y][x] = 0;
                                 acidTimer[y][x] = 0;
                                 fireTimer[y][x] = 0;
-                                gasTimer[y][x] = 0;
-                                gasCooldown[y][x] = 0;
-                                acidGasCooldown[y][x] = 0;
+                                gasDensity[y][x] = 0;
+                                acidGasDensity[y][x] = 0;
                                 steamTimer[y][x] = 0;
                             }
                             else if (currentMaterial != GRASS_SEED) {
@@ -808,99 +3953,78 @@ int main() {
             }
         }
 
+        int viewWidth = GetScreenWidth() - TOOLBAR_WIDTH;
+        int viewHeight = GetScreenHeight();
+        if (viewWidth < 1) viewWidth = 1;
+        if (viewHeight < 1) viewHeight = 1;
+
+        // Ctrl + wheel zooms around the cursor, the plain wheel sizes the brush
         int wheelMove = GetMouseWheelMove();
-        if (wheelMove != 0) {
+        if (wheelMove != 0 && (IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL))) {
+            float anchorX = cameraX + (mousePos.x - TOOLBAR_WIDTH) / zoom;
+            float anchorY = cameraY + mousePos.y / zoom;
+            zoom *= (wheelMove > 0) ? 1.25f : 0.8f;
+            if (zoom < MIN_ZOOM) zoom = MIN_ZOOM;
+            if (zoom > MAX_ZOOM) zoom = MAX_ZOOM;
+            cameraX = anchorX - (mousePos.x - TOOLBAR_WIDTH) / zoom;
+            cameraY = anchorY - mousePos.y / zoom;
+        }
+        else if (wheelMove != 0) {
             brushSize += wheelMove;
             if (brushSize < 1) brushSize = 1;
             if (brushSize > 10) brushSize = 10;
         }
 
-        for (int y = 0; y < gridHeight; y++) {
-            for (int x = 0; x < gridWidth; x++) {
-                updated[y][x] = false;
-            }
+        // Right mouse button drags the view, arrow keys pan, Home resets
+        if (IsMouseButtonDown(MOUSE_RIGHT_BUTTON)) {
+            Vector2 delta = GetMouseDelta();
+            cameraX -= delta.x / zoom;
+            cameraY -= delta.y / zoom;
         }
-
-        for (int y = gridHeight - 1; y >= 0; y--) {
-            for (int x = 0; x < gridWidth; x++) {
-                if (!updated[y][x]) {
-                    if (grid[y][x] == SAND) {
-                        if (updateSand(gridHeight, gridWidth, grid, x, y)) {
-                            updated[y][x] = true;
-                        }
-                    }
-                    else if (grid[y][x] == WATER) {
-                        if (updateWater(gridHeight, gridWidth, grid, x, y)) {
-                            updated[y][x] = true;
-                        }
-                    }
-                    else if (grid[y][x] == ACID) {
-                        if (updateAcid(gridHeight, gridWidth, grid, acidStage, acidTimer, acidGasCooldown, x, y)) {
-                            updated[y][x] = true;
-                        }
-                    }
-                    else if (grid[y][x] == GAS) {
-                        if (updateGas(gridHeight, gridWidth, grid, gasTimer, gasCooldown, x, y, fireTimer)) {
-                            updated[y][x] = true;
-                        }
-                    }
-                    else if (grid[y][x] == FIRE) {
-                        if (updateFire(gridHeight, gridWidth, grid, fireTimer, steamTimer, x, y)) {
-                            updated[y][x] = true;
-                        }
-                    }
-                    else if (grid[y][x] == ACID_GAS) {
-                        if (updateAcidGas(gridHeight, gridWidth, grid, acidTimer, acidStage, acidGasCooldown, x, y)) {
-                            updated[y][x] = true;
-                        }
-                    }
-                    else if (grid[y][x] == STEAM) {
-                        if (updateSteam(gridHeight, gridWidth, grid, steamTimer, x, y)) {
-                            updated[y][x] = true;
-                        }
-                    }
-                    else if (grid[y][x] == RAIN) {
-                        if (updateRain(gridHeight, gridWidth, grid, x, y)) {
-                            updated[y][x] = true;
-                        }
-                    }
-                    else if (grid[y][x] == DIRT) {
-                        if (updateDirt(gridHeight, gridWidth, grid, x, y)) {
-                            updated[y][x] = true;
-                        }
-                    }
-                    else if (grid[y][x] == GRASS_SEED) {
-                        if (updateGrassSeed(gridHeight, gridWidth, grid, x, y)) {
-                            updated[y][x] = true;
-                        }
-                    }
-                }
-            }
+        float panStep = 20.0f / zoom;
+        if (IsKeyDown(KEY_LEFT)) cameraX -= panStep;
+        if (IsKeyDown(KEY_RIGHT)) cameraX += panStep;
+        if (IsKeyDown(KEY_UP)) cameraY -= panStep;
+        if (IsKeyDown(KEY_DOWN)) cameraY += panStep;
+        // G fills the world with a new generated landscape
+        if (IsKeyPressed(KEY_G)) {
+            generateSeed = (unsigned int)GetRandomValue(1, 0x7fffffff);
+            generateWorld(&world, generateSeed);
+        }
+        if (IsKeyPressed(KEY_HOME)) {
+            cameraX = 0.0f;
+            cameraY = 0.0f;
+            zoom = gridSize;
         }
 
-        evaporationCounter++;
-        if (evaporationCounter >= evaporationTime) {
-            evaporationCounter = 0;
+        float maxCameraX = gridWidth - viewWidth / zoom;
+        float maxCameraY = gridHeight - viewHeight / zoom;
+        if (cameraX > maxCameraX) cameraX = maxCameraX;
+        if (cameraY > maxCameraY) cameraY = maxCameraY;
+        if (cameraX < 0.0f) cameraX = 0.0f;
+        if (cameraY < 0.0f) cameraY = 0.0f;
 
-            int evaporated = 0;
-            for (int y = 0; y < gridHeight && evaporated < maxEvaporationsPerFrame; y++) {
-                for (int x = 0; x < gridWidth && evaporated < maxEvaporationsPerFrame; x++) {
-                    if (grid[y][x] == ACID && acidTimer[y][x] >= evaporationTime) {
-                        grid[y][x] = EMPTY;
-                        acidStage[y][x] = 0;
-                        acidTimer[y][x] = 0;
-                        evaporated++;
-                    }
-                }
-            }
+        stepWorld(&world);
+
+        // `world.tick` counts completed steps, so checkpoints and frames are taken at tick boundaries
+        long start = nowNanos();
+        if (checkpointDir != NULL && world.tick % checkpointInterval == 0) {
+            int** planes[CHECKPOINT_PLANES];
+            worldPlanes(&world, planes);
+            writeCheckpoint(&checkpoints, gridHeight, gridWidth, planes, world.chunkUnsaved, world.tick);
+            addPhaseTime(PHASE_CHECKPOINT, start);
+        }
+        start = nowNanos();
+        if (capturing && world.tick % captureInterval == 0) {
+            captureFrame(&capture, gridHeight, gridWidth, grid, world.tick);
+            addPhaseTime(PHASE_CAPTURE, start);
         }
 
+        // Render time covers building the frame, not the wait for vsync in EndDrawing
+        start = nowNanos();
         BeginDrawing();
             ClearBackground((Color){0, 0, 0, 255});
 
-            // Draw brush size in top-right corner
-            DrawText(TextFormat("Brush Size: %d", brushSize), GetScreenWidth() - 150, 10, 20, WHITE);
-
             DrawRectangleRec(sandButton, YELLOW);
             DrawRectangleRec(waterButton, BLUE);
             DrawRectangleRec(stoneButton, DARKGRAY);
@@ -943,90 +4067,109 @@ int main() {
                 DrawRectangleLinesEx(grassSeedButton, 3, WHITE);
             }
 
-            for (int y = 0; y < gridHeight; y++) {
-                for (int x = 0; x < gridWidth; x++) {
-                    int posX = 150 + x * gridSize;
-                    int posY = y * gridSize;
-
-                    if (grid[y][x] == SAND) {
-                        DrawRectangle(posX, posY, gridSize, gridSize, YELLOW);
-                    } else if (grid[y][x] == WATER) {
-                        if (acidStage[y][x] > 0) {
-                            float blendRatio = (float)acidStage[y][x] / 4.0f;
-                            Color waterColor = {
-                                (unsigned char)(0 * (1.0f - blendRatio) + acidColors[acidStage[y][x]].r * blendRatio),
-                                (unsigned char)(105 * (1.0f - blendRatio) + acidColors[acidStage[y][x]].g * blendRatio),
-                                (unsigned char)(148 * (1.0f - blendRatio) + acidColors[acidStage[y][x]].b * blendRatio),
-                                200
-                            };
-                            DrawRectangle(posX, posY, gridSize, gridSize, waterColor);
-                        } else {
-                            DrawRectangle(posX, posY, gridSize, gridSize, (Color){0, 105, 148, 200});
+            if (zoom >= LOD_MIN_ZOOM) {
+                // Close up: one rectangle per visible cell
+                int firstX = (int)cameraX;
+                int firstY = (int)cameraY;
+                int lastX = (int)(cameraX + viewWidth / zoom) + 1;
+                int lastY = (int)(cameraY + viewHeight / zoom) + 1;
+                if (lastX > gridWidth) lastX = gridWidth;
+                if (lastY > gridHeight) lastY = gridHeight;
+                int cellPixels = (int)ceilf(zoom);
+
+                for (int y = firstY; y < lastY; y++) {
+                    for (int x = firstX; x < lastX; x++) {
+                        if (grid[y][x] == EMPTY) continue;
+                        int posX = TOOLBAR_WIDTH + (int)((x - cameraX) * zoom);
+                        int posY = (int)((y - cameraY) * zoom);
+                        DrawRectangle(posX, posY, cellPixels, cellPixels, cellColor(grid, timerPlanes, x, y));
+                    }
+                }
+            } else {
+                // Zoomed out: fill a screen-sized texture from the cells or from the chunk
+                // pyramids, so the cost follows the pixel count rather than the world size
+                if (viewTextureWidth != viewWidth || viewTextureHeight != viewHeight) {
+                    if (viewPixels != NULL) {
+                        UnloadTexture(viewTexture);
+                        free(viewPixels);
+                    }
+                    Image image = GenImageColor(viewWidth, viewHeight, BLACK);
+                    viewTexture = LoadTextureFromImage(image);
+                    UnloadImage(image);
+                    viewPixels = (Color *)malloc((size_t)viewWidth * viewHeight * sizeof(Color));
+                    viewTextureWidth = viewWidth;
+                    viewTextureHeight = viewHeight;
+                }
+
+                // Use the finest pyramid level whose texels are at least one pixel wide
+                int level = 0;
+                while (level < CHUNK_LOD_LEVELS && zoom * (1 << level) < 1.0f) {
+                    level++;
+                }
+                int texelsPerSide = CHUNK_SIZE >> level;
+
+                if (level > 0) {
+                    int firstChunkX = (int)cameraX / CHUNK_SIZE;
+                    int firstChunkY = (int)cameraY / CHUNK_SIZE;
+                    int lastChunkX = (int)(cameraX + viewWidth / zoom) / CHUNK_SIZE;
+                    int lastChunkY = (int)(cameraY + viewHeight / zoom) / CHUNK_SIZE;
+                    if (lastChunkX >= chunksX) lastChunkX = chunksX - 1;
+                    if (lastChunkY >= chunksY) lastChunkY = chunksY - 1;
+
+                    for (int cy = firstChunkY; cy <= lastChunkY; cy++) {
+                        for (int cx = firstChunkX; cx <= lastChunkX; cx++) {
+                            if (chunkDirty[cy * chunksX + cx]) {
+                                rebuildChunkLod(chunkLod + (size_t)(cy * chunksX + cx) * CHUNK_LOD_TEXELS,
+                                                gridHeight, gridWidth, grid, timerPlanes, cx, cy);
+                                chunkDirty[cy * chunksX + cx] = false;
+                            }
+                        }
+                    }
+                }
+
+                float cellsPerPixel = 1.0f / zoom;
+                for (int py = 0; py < viewHeight; py++) {
+                    int y = (int)(cameraY + py * cellsPerPixel);
+                    for (int px = 0; px < viewWidth; px++) {
+                        int x = (int)(cameraX + px * cellsPerPixel);
+                        Color color = BLACK;
+                        if (x < gridWidth && y < gridHeight) {
+                            if (level == 0) {
+                                color = cellDisplayColor(grid, timerPlanes, x, y);
+                            } else {
+                                Color* lod = chunkLod + (size_t)((y / CHUNK_SIZE) * chunksX + x / CHUNK_SIZE) * CHUNK_LOD_TEXELS;
+                                int tx = (x % CHUNK_SIZE) >> level;
+                                int ty = (y % CHUNK_SIZE) >> level;
+                                color = lod[lodLevelOffsets[level] + ty * texelsPerSide + tx];
+                            }
                         }
-                    } else if (grid[y][x] == STONE) {
-                        DrawRectangle(posX, posY, gridSize, gridSize, DARKGRAY);
-                    } else if (grid[y][x] == ACID) {
-                        float alpha = acidTimer[y][x] > evaporationTime * 0.8f ?
-                                     200.0f * (1.0f - (acidTimer[y][x] - evaporationTime * 0.8f) / (evaporationTime * 0.2f)) :
-                                     200.0f;
-                        Color acidColor = acidColors[0];
-                        acidColor.a = alpha;
-                        DrawRectangle(posX, posY, gridSize, gridSize, acidColor);
-                    } else if (grid[y][x] == GAS) {
-                        float alpha = 150.0f * (1.0f - (float)gasTimer[y][x] / 600.0f);
-                        if (alpha < 0) alpha = 0;
-                        DrawRectangle(posX, posY, gridSize, gridSize, (Color){200, 200, 200, (unsigned char)alpha});
-                    } else if (grid[y][x] == FIRE) {
-                        int colorIndex = (fireTimer[y][x] + x + y) % 5;
-                        DrawRectangle(posX, posY, gridSize, gridSize, fireColors[colorIndex]);
-                    } else if (grid[y][x] == ACID_GAS) {
-                        Color gasColor = acidGasColors[acidStage[y][x]];
-                        float progress = (float)acidTimer[y][x] / 180.0f;
-                        gasColor.a = (unsigned char)(gasColor.a * progress);
-                        DrawRectangle(posX, posY, gridSize, gridSize, gasColor);
-                    } else if (grid[y][x] == STEAM) {
-                        int colorIndex = steamTimer[y][x] / 600;
-                        if (colorIndex > 2) colorIndex = 2;
-                        Color steamColor = steamColors[colorIndex];
-                        
-                        float progress = (float)steamTimer[y][x] / 1800.0f;
-                        steamColor.a = 255 * (1.0f - progress * 0.7f);
-                        
-                        DrawRectangle(posX, posY, gridSize, gridSize, steamColor);
-                    } else if (grid[y][x] == RAIN) {
-                        DrawRectangle(posX, posY, gridSize, gridSize, rainColor);
-                    } else if (grid[y][x] == DIRT) {
-                        DrawRectangle(posX, posY, gridSize, gridSize, (Color){139, 69, 19, 255}); // Brown
-                    } else if (grid[y][x] == GRASS_SEED) {
-                        DrawRectangle(posX, posY, gridSize, gridSize, (Color){205, 133, 63, 255}); // Light brown
-                    } else if (grid[y][x] == GRASS) {
-                        DrawRectangle(posX, posY, gridSize, gridSize, (Color){0, 128, 0, 255}); // Green
+                        viewPixels[py * viewWidth + px] = color;
                     }
                 }
+                UpdateTexture(viewTexture, viewPixels);
+                DrawTexture(viewTexture, TOOLBAR_WIDTH, 0, WHITE);
             }
+
+            // Draw brush size in top-right corner
+            DrawText(TextFormat("Brush Size: %d", brushSize), GetScreenWidth() - 150, 10, 20, WHITE);
+            addPhaseTime(PHASE_RENDER, start);
         EndDrawing();
     }
 
-    for (int y = 0; y < gridHeight; y++) {
-        free(grid[y]);
-        free(acidStage[y]);
-        free(acidTimer[y]);
-        free(fireTimer[y]);
-        free(gasTimer[y]);
-        free(gasCooldown[y]);
-        free(acidGasCooldown[y]);
-        free(steamTimer[y]);
-        free(updated[y]);
-    }
-    free(grid);
-    free(acidStage);
-    free(acidTimer);
-    free(fireTimer);
-    free(gasTimer);
-    free(gasCooldown);
-    free(acidGasCooldown);
-    free(steamTimer);
-    free(updated);
+    if (serving) {
+        stopMetricsServer(&metrics);
+    }
+    destroyWorld(&world);
+    if (capturing) {
+        stopCapture(&capture);
+    }
+    if (checkpointDir != NULL) {
+        freeCheckpoints(&checkpoints);
+    }
+    if (viewPixels != NULL) {
+        UnloadTexture(viewTexture);
+        free(viewPixels);
+    }
 
     CloseWindow();
     return 0;